@@ -0,0 +1,256 @@
+// SketchMate batch renderer: turns saved documents (.smk) into PNG/JPG images without a
+// display, GL context or GLFW. Built from the same drawing code as the GUI (document_file,
+// raster, image_writer), so an image matches what the canvas shows.
+//
+//   sketchmate_batch [options] drawing.smk [other.smk=out/other.jpg ...]
+//
+// Each input is written next to itself (or into --out-dir) with the --format extension,
+// unless it names its own output after '='.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib> // For std::atoi, std::atof, std::strtoul
+
+#include "document_file.h"
+#include "raster.h"
+#include "canvas_layout.h"
+#include "image_writer.h"
+#include "thread_pool.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// --- Settings ---
+std::string outputDirectory; // --out-dir DIR (default: next to each input)
+std::string outputFormat = "png"; // --format png|jpg
+int outputWidth = 0, outputHeight = 0; // --width PX / --height PX (the other side keeps the aspect)
+float outputScale = 1.0f; // --scale S: image pixels per screen pixel, if no size is given
+int referenceWidth = DEFAULT_WINDOW_WIDTH, referenceHeight = DEFAULT_WINDOW_HEIGHT; // --window WxH
+float background[3] = {1.0f, 1.0f, 1.0f}; // --background RRGGBB
+bool customBackground = false; // Erased areas then show the background instead of the editor's color
+float region[4] = {SIDEBAR_RIGHT_GL, DRAWING_AREA_BOTTOM_GL, 1.0f, CANVAS_TOP_GL}; // --region L,B,R,T (GL)
+int jpgQuality = 90; // --quality Q
+unsigned threadCount = 0; // --jobs N (0 = one per hardware thread)
+
+struct BatchJob {
+    std::string input, output;
+    // Results
+    bool ok = false;
+    std::string message;
+    int width = 0, height = 0;
+    size_t strokes = 0;
+    double loadMs = 0.0, renderMs = 0.0;
+};
+
+// --- Helper Functions ---
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Helper: Output path for an input: same name with the format's extension, in --out-dir if given
+std::string defaultOutputPath(const std::string& input) {
+    size_t slash = input.find_last_of("/\\");
+    size_t dot = input.rfind('.');
+    std::string stem = input.substr(0, (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? dot : input.size());
+    if (!outputDirectory.empty()) {
+        std::string name = stem.substr(slash == std::string::npos ? 0 : slash + 1);
+        char last = outputDirectory.back();
+        stem = outputDirectory + ((last == '/' || last == '\\') ? "" : "/") + name;
+    }
+    return stem + "." + outputFormat;
+}
+
+// Helper: Parses "RRGGBB" (an optional leading '#' is skipped)
+bool parseColor(std::string text, float color[3]) {
+    if (!text.empty() && text[0] == '#') text.erase(0, 1);
+    if (text.size() != 6 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) return false;
+    unsigned long value = std::strtoul(text.c_str(), nullptr, 16);
+    color[0] = ((value >> 16) & 0xFF) / 255.0f;
+    color[1] = ((value >> 8) & 0xFF) / 255.0f;
+    color[2] = (value & 0xFF) / 255.0f;
+    return true;
+}
+
+// --- Rendering ---
+
+// Loads one document and writes its image; `pool` (if any) parallelizes its tiles
+void runJob(BatchJob& job, ThreadPool* pool) {
+    auto start = std::chrono::steady_clock::now();
+    auto document = std::make_shared<Document>();
+    DocumentFile file;
+    if (!file.open(job.input, job.message)) return;
+    file.load(*document);
+    job.strokes = document->strokes.size();
+    job.loadMs = millisecondsSince(start);
+
+    // Stroke sizes are screen pixels of the reference window; the region is scaled with it.
+    // Its pixel size is truncated like canvasPixelSize(), so the default region at scale 1 is
+    // exactly the editor's canvas, and scaled sizes are rounded like the editor's export.
+    int regionWidthPx = std::max(1, static_cast<int>((region[2] - region[0]) / 2.0f * referenceWidth));
+    int regionHeightPx = std::max(1, static_cast<int>((region[3] - region[1]) / 2.0f * referenceHeight));
+    float scale = outputWidth > 0 ? static_cast<float>(outputWidth) / regionWidthPx
+                : outputHeight > 0 ? static_cast<float>(outputHeight) / regionHeightPx : outputScale;
+    job.width = outputWidth > 0 ? outputWidth : std::max(1, static_cast<int>(std::lround(regionWidthPx * scale)));
+    job.height = outputHeight > 0 ? outputHeight : std::max(1, static_cast<int>(std::lround(regionHeightPx * scale)));
+
+    RasterOptions options = canvasRasterOptions(scale);
+    options.left = region[0]; options.bottom = region[1]; options.right = region[2]; options.top = region[3];
+    std::copy(background, background + 3, options.background);
+    if (customBackground) std::copy(background, background + 3, options.eraserColor);
+
+    ImageJob image;
+    image.path = job.output;
+    image.width = job.width;
+    image.height = job.height;
+    image.jpgQuality = jpgQuality;
+    auto rasterizer = std::make_shared<Rasterizer>(pool);
+    int width = job.width, height = job.height;
+    image.renderRows = [document, options, rasterizer, width, height](int firstRow, int rowCount, std::vector<uint8_t>& rgba) {
+        RgbaImage band;
+        band.pixels.swap(rgba);
+        rasterizer->renderRows(*document, options, width, height, firstRow, rowCount, band);
+        rgba.swap(band.pixels);
+        return true;
+    };
+    start = std::chrono::steady_clock::now();
+    job.ok = ImageWriter::write(image, job.message);
+    job.renderMs = millisecondsSince(start);
+}
+
+// Parses the flags and inputs; false on a usage error
+bool parseCommandLine(int argc, char** argv, std::vector<BatchJob>& jobs) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out-dir" && hasValue) {
+            outputDirectory = argv[++i];
+        } else if (arg == "--format" && hasValue) {
+            outputFormat = argv[++i];
+            if (outputFormat == "jpeg") outputFormat = "jpg";
+            if (outputFormat != "png" && outputFormat != "jpg") {
+                std::cerr << "Unknown format: " << outputFormat << std::endl;
+                return false;
+            }
+        } else if (arg == "--width" && hasValue) {
+            outputWidth = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--height" && hasValue) {
+            outputHeight = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--scale" && hasValue) {
+            outputScale = std::max(0.01f, static_cast<float>(std::atof(argv[++i])));
+        } else if (arg == "--window" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &referenceWidth, &referenceHeight) != 2 || referenceWidth <= 0 || referenceHeight <= 0) {
+                std::cerr << "Expected --window WIDTHxHEIGHT" << std::endl;
+                return false;
+            }
+        } else if (arg == "--background" && hasValue) {
+            if (!parseColor(argv[++i], background)) {
+                std::cerr << "Expected --background RRGGBB" << std::endl;
+                return false;
+            }
+            customBackground = true;
+        } else if (arg == "--region" && hasValue) {
+            std::string value = argv[++i];
+            if (value == "window") {
+                region[0] = -1.0f; region[1] = -1.0f; region[2] = 1.0f; region[3] = 1.0f;
+            } else if (value == "canvas") {
+                region[0] = SIDEBAR_RIGHT_GL; region[1] = DRAWING_AREA_BOTTOM_GL; region[2] = 1.0f; region[3] = CANVAS_TOP_GL;
+            } else if (std::sscanf(value.c_str(), "%f,%f,%f,%f", &region[0], &region[1], &region[2], &region[3]) != 4 ||
+                       region[2] <= region[0] || region[3] <= region[1]) {
+                std::cerr << "Expected --region canvas|window|LEFT,BOTTOM,RIGHT,TOP (GL coordinates)" << std::endl;
+                return false;
+            }
+        } else if (arg == "--quality" && hasValue) {
+            jpgQuality = std::max(1, std::min(100, std::atoi(argv[++i])));
+        } else if (arg == "--jobs" && hasValue) {
+            threadCount = static_cast<unsigned>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else {
+            BatchJob job;
+            size_t equals = arg.find('=');
+            job.input = arg.substr(0, equals);
+            if (equals != std::string::npos) job.output = arg.substr(equals + 1);
+            jobs.push_back(job);
+        }
+    }
+    for (auto& job : jobs) {
+        if (job.output.empty()) job.output = defaultOutputPath(job.input); // After every flag is known
+    }
+    return !jobs.empty();
+}
+
+void printUsage() {
+    std::cerr << "Usage: sketchmate_batch [options] DOCUMENT.smk[=OUTPUT.png|jpg] ...\n"
+                 "  --out-dir DIR         Write images into DIR (default: next to each document)\n"
+                 "  --format png|jpg      Image format for outputs not named explicitly (default png)\n"
+                 "  --width PX            Image width; --height PX image height (aspect kept if only one)\n"
+                 "  --scale S             Image pixels per screen pixel if no size is given (default 1)\n"
+                 "  --window WxH          Window size the drawing was made in (default 1000x700)\n"
+                 "  --region R            canvas (default), window, or LEFT,BOTTOM,RIGHT,TOP in GL units\n"
+                 "  --background RRGGBB   Canvas color, also used for erased areas (default FFFFFF)\n"
+                 "  --quality Q           JPG quality 1-100 (default 90)\n"
+                 "  --jobs N              Threads to use (default: one per core)\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<BatchJob> jobs;
+    if (!parseCommandLine(argc, argv, jobs)) {
+        printUsage();
+        return 2;
+    }
+
+    // Spread whole documents across the cores when there are enough of them; otherwise render
+    // one document at a time with its tiles spread across the cores
+    ThreadPool pool(threadCount);
+    bool perDocument = jobs.size() >= pool.size();
+    std::mutex outputMutex;
+    size_t finished = 0;
+    auto report = [&](const BatchJob& job) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        ++finished;
+        std::cout << "[" << finished << "/" << jobs.size() << "] ";
+        if (job.ok) {
+            char timing[128];
+            std::snprintf(timing, sizeof(timing), "load %.1f ms, render+encode %.1f ms", job.loadMs, job.renderMs);
+            std::cout << job.input << " -> " << job.output << " (" << job.width << "x" << job.height << ", "
+                      << job.strokes << " strokes): " << timing << std::endl;
+        } else {
+            std::cout << job.input << ": " << job.message << std::endl;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    if (perDocument) {
+        pool.parallelFor(jobs.size(), [&](size_t i) {
+            runJob(jobs[i], nullptr);
+            report(jobs[i]);
+        });
+    } else {
+        for (auto& job : jobs) {
+            runJob(job, &pool);
+            report(job);
+        }
+    }
+    double totalMs = millisecondsSince(start);
+
+    size_t failed = 0;
+    double megapixels = 0.0;
+    for (const auto& job : jobs) {
+        if (!job.ok) ++failed;
+        else megapixels += job.width * static_cast<double>(job.height) / 1e6;
+    }
+    char summary[256];
+    std::snprintf(summary, sizeof(summary), "Rendered %zu of %zu documents in %.2f s on %u threads: %.2f documents/s, %.1f Mpx/s",
+                  jobs.size() - failed, jobs.size(), totalMs / 1000.0, pool.size(),
+                  (jobs.size() - failed) / std::max(totalMs / 1000.0, 1e-9), megapixels / std::max(totalMs / 1000.0, 1e-9));
+    std::cout << summary << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,572 @@
+// SketchMate benchmark: generates a synthetic document, replays it through the editor's
+// commit path and times the operations that decide how the editor scales. No display, GL
+// context or GLFW is needed; drawing-side numbers come from the CPU rasterizer (raster.h),
+// which draws exactly what the canvas shows.
+//
+//   sketchmate_bench [options] [--output results.json]
+//
+// Results are written as one JSON object (stdout by default) so runs of different builds can
+// be compared by a script. Times are in microseconds unless a key says otherwise.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib> // For std::atoi, std::atof
+
+#include "history.h"
+#include "curves.h"
+#include "simplify.h"
+#include "flood_fill.h"
+#include "raster.h"
+#include "canvas_layout.h"
+#include "image_writer.h"
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// --- Settings ---
+size_t strokeCount = 10000; // --strokes N
+int pointsPerStroke = 200; // --points N: raw input samples per freehand stroke
+float minSize = 2.0f, maxSize = 20.0f; // --sizes MIN-MAX (screen pixels)
+// --mix brush:70,eraser:10,...: relative weight of each tool in the generated document
+float toolWeights[TOOL_MASK_FILL + 1] = {};
+unsigned randomSeed = 1; // --seed N
+int windowWidth = DEFAULT_WINDOW_WIDTH, windowHeight = DEFAULT_WINDOW_HEIGHT; // --window WxH
+bool reduceStrokes = true; // --no-reduce: commit raw samples (no curve fit / simplification)
+int redrawRuns = 3; // --redraws N
+size_t undoSteps = 200; // --undo N
+size_t checkpointInterval = 64; // --checkpoint-interval N: strokes between undo snapshots, as in the editor
+const size_t CHECKPOINT_MEMORY_BUDGET = 256u * 1024u * 1024u; // The editor's default snapshot budget
+int fillSeeds = 50; // --fills N: bucket fills (and as many batches of 1000 point hit-tests)
+int exportWidth = 2000; // --export-width PX (height keeps the canvas aspect; 0 skips the export)
+std::string exportPath = "sketchmate_bench_export.png"; // --export-path FILE (removed afterwards)
+unsigned threadCount = 0; // --jobs N (0 = one per hardware thread)
+std::string outputPath; // --output FILE (default: stdout)
+
+const char* TOOL_NAMES[] = {"brush", "eraser", "rect", "circle", "line", "fill", "mask"};
+
+// --- Helper Functions ---
+
+using Clock = std::chrono::steady_clock;
+
+double microsecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Helper: Largest resident set of the process so far, in bytes (0 if unknown)
+size_t peakMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes elsewhere
+#endif
+#endif
+}
+
+// Durations of one kind of operation, summarized as count/mean/percentiles
+struct Samples {
+    std::vector<double> values;
+
+    void add(double value) { values.push_back(value); }
+    double total() const {
+        double sum = 0.0;
+        for (double v : values) sum += v;
+        return sum;
+    }
+    double percentile(std::vector<double>& sorted, double p) const {
+        if (sorted.empty()) return 0.0;
+        size_t i = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[std::min(sorted.size() - 1, i > 0 ? i - 1 : 0)];
+    }
+    std::string json() const {
+        std::vector<double> sorted(values);
+        std::sort(sorted.begin(), sorted.end());
+        char text[256];
+        std::snprintf(text, sizeof(text),
+                      "{\"count\": %zu, \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"total\": %.3f}",
+                      sorted.size(), sorted.empty() ? 0.0 : total() / sorted.size(), percentile(sorted, 50),
+                      percentile(sorted, 95), percentile(sorted, 99), sorted.empty() ? 0.0 : sorted.back(), total());
+        return text;
+    }
+};
+
+// Helper: Escapes a string for a JSON value
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Helper: Parses "brush:70,eraser:10,fill:5" into toolWeights; false on an unknown tool
+bool parseToolMix(const std::string& text) {
+    std::fill(std::begin(toolWeights), std::end(toolWeights), 0.0f);
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        size_t colon = item.find(':');
+        std::string name = item.substr(0, colon);
+        float weight = colon == std::string::npos ? 1.0f : static_cast<float>(std::atof(item.c_str() + colon + 1));
+        auto found = std::find(std::begin(TOOL_NAMES), std::end(TOOL_NAMES), name);
+        if (found == std::end(TOOL_NAMES) || weight < 0.0f) return false;
+        toolWeights[found - std::begin(TOOL_NAMES)] = weight;
+    }
+    for (float weight : toolWeights) {
+        if (weight > 0.0f) return true;
+    }
+    return false;
+}
+
+// --- Synthetic Documents ---
+// Strokes are made the way a user makes them: freehand tools produce raw input samples about
+// two screen pixels apart along a wandering path, then go through the same reduction and
+// History::commit as in the editor. Everything stays inside the canvas area.
+
+class StrokeGenerator {
+public:
+    StrokeGenerator(unsigned seed) : random_(seed), tools_(std::begin(toolWeights), std::end(toolWeights)) {}
+
+    // Makes the next stroke; freehand samples are appended to a new chain of `document.arena`
+    Stroke next(Document& document) {
+        Stroke stroke;
+        stroke.tool = tools_(random_);
+        stroke.size = uniform(minSize, maxSize);
+        for (float& channel : stroke.color) channel = uniform(0.0f, 1.0f);
+        Point a = randomPoint(), b = randomPoint();
+        switch (stroke.tool) {
+            case TOOL_BRUSH:
+            case TOOL_ERASER:
+                stroke.freehand = PointArena::emptyRef();
+                drawPath(document, stroke.freehand, a);
+                break;
+            case TOOL_RECTANGLE:
+                stroke.rect.start = a;
+                stroke.rect.end = b;
+                break;
+            case TOOL_CIRCLE:
+                stroke.circle.center = a;
+                stroke.circle.radius = uniform(0.02f, 0.3f);
+                break;
+            case TOOL_LINE:
+                stroke.line.start = a;
+                stroke.line.end = b;
+                break;
+            case TOOL_FILL:
+                stroke.fill.min = Point(std::min(a.x, b.x), std::min(a.y, b.y));
+                stroke.fill.max = Point(std::max(a.x, b.x), std::max(a.y, b.y));
+                stroke.fill.radius = 0.0f; // Rectangle
+                break;
+            case TOOL_MASK_FILL:
+                makeMask(document, stroke, a);
+                break;
+        }
+        return stroke;
+    }
+
+private:
+    float uniform(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(random_); }
+    Point randomPoint() { return Point(uniform(SIDEBAR_RIGHT_GL, 1.0f), uniform(DRAWING_AREA_BOTTOM_GL, CANVAS_TOP_GL)); }
+
+    // A smooth random walk: the heading drifts a little at every sample
+    void drawPath(Document& document, FreehandRef& ref, Point position) {
+        float heading = uniform(0.0f, 6.2831853f), turn = 0.0f;
+        float stepX = 2.0f * 2.0f / windowWidth, stepY = 2.0f * 2.0f / windowHeight;
+        for (int i = 0; i < pointsPerStroke; ++i) {
+            document.arena.append(ref, position);
+            turn = 0.9f * turn + uniform(-0.05f, 0.05f);
+            heading += turn;
+            position.x += std::cos(heading) * stepX;
+            position.y += std::sin(heading) * stepY;
+            // Turn back at the canvas edges
+            if (position.x < SIDEBAR_RIGHT_GL || position.x > 1.0f) { heading = 3.1415927f - heading; position.x = std::max(SIDEBAR_RIGHT_GL, std::min(1.0f, position.x)); }
+            if (position.y < DRAWING_AREA_BOTTOM_GL || position.y > CANVAS_TOP_GL) { heading = -heading; position.y = std::max(DRAWING_AREA_BOTTOM_GL, std::min(CANVAS_TOP_GL, position.y)); }
+        }
+    }
+
+    // A bucket-fill mask in window pixels: an ellipse of runs, as a fill of a closed shape leaves
+    void makeMask(Document& document, Stroke& stroke, Point center) {
+        int radiusX = static_cast<int>(uniform(5.0f, 120.0f)), radiusY = static_cast<int>(uniform(5.0f, 120.0f));
+        int centerX = static_cast<int>((center.x + 1.0f) / 2.0f * windowWidth);
+        int centerY = static_cast<int>((center.y + 1.0f) / 2.0f * windowHeight);
+        int originX = std::max(0, centerX - radiusX), originY = std::max(0, centerY - radiusY);
+        std::vector<MaskRun> runs;
+        for (int dy = -radiusY; dy <= radiusY; ++dy) {
+            int y = centerY + dy - originY;
+            if (y < 0) continue;
+            int half = static_cast<int>(radiusX * std::sqrt(1.0f - (dy * dy) / static_cast<float>(radiusY * radiusY)));
+            int x0 = std::max(0, centerX - half - originX), x1 = centerX + half + 1 - originX;
+            runs.push_back({static_cast<uint16_t>(y), static_cast<uint16_t>(x0), static_cast<uint16_t>(x1)});
+        }
+        stroke.mask.runCount = static_cast<uint32_t>(runs.size());
+        stroke.mask.mask = document.masks.add(std::move(runs));
+        stroke.mask.origin = Point(originX * 2.0f / windowWidth - 1.0f, originY * 2.0f / windowHeight - 1.0f);
+        stroke.mask.pixelWidth = 2.0f / windowWidth;
+        stroke.mask.pixelHeight = 2.0f / windowHeight;
+    }
+
+    std::mt19937 random_;
+    std::discrete_distribution<int> tools_;
+};
+
+// --- Benchmarks ---
+
+struct Results {
+    // Document
+    size_t rawPoints = 0, storedPoints = 0;
+    size_t documentBytes = 0, historyBytes = 0;
+    // Timings
+    Samples commit, redraw, undo, redo, clear, undoClear, fill, hitTest;
+    double generateMs = 0.0, exportMs = 0.0;
+    size_t exportBytes = 0, filledPixels = 0;
+    int canvasWidth = 0, canvasHeight = 0, exportHeight = 0;
+    size_t checkpoints = 0, checkpointStrokes = 0; // Undo snapshots taken, and strokes between them
+    std::string exportError;
+};
+
+// Replays the generated strokes through the editor's commit path, timing each commit
+void benchmarkCommits(Document& document, History& history, Results& results) {
+    StrokeGenerator generator(randomSeed);
+    CurveFitter curveFitter;
+    StrokeSimplifier simplifier;
+    CurveScale scale;
+    scale.pixelsPerUnitX = windowWidth / 2.0f;
+    scale.pixelsPerUnitY = windowHeight / 2.0f;
+    SimplifySettings settings;
+    settings.pixelsPerUnitX = scale.pixelsPerUnitX;
+    settings.pixelsPerUnitY = scale.pixelsPerUnitY;
+
+    double generating = 0.0;
+    for (size_t i = 0; i < strokeCount; ++i) {
+        auto start = Clock::now();
+        Stroke stroke = generator.next(document);
+        generating += microsecondsSince(start);
+
+        start = Clock::now();
+        if (isFreehandTool(stroke.tool)) {
+            results.rawPoints += stroke.freehand.count;
+            // As reduceFreehandStroke() in main.cpp, with its default tolerances
+            if (reduceStrokes && !curveFitter.fit(document.arena, stroke.freehand, 0.5f, scale)) {
+                simplifier.simplify(document.arena, stroke.freehand, stroke.size, settings);
+            }
+            results.storedPoints += stroke.freehand.count;
+        }
+        history.commit(stroke);
+        results.commit.add(microsecondsSince(start));
+    }
+    results.generateMs = generating / 1000.0;
+}
+
+// Full redraws of the canvas at window resolution
+void benchmarkRedraw(const Document& document, ThreadPool& pool, Results& results) {
+    canvasPixelSize(windowWidth, windowHeight, results.canvasWidth, results.canvasHeight);
+    Rasterizer rasterizer(&pool);
+    RasterOptions options = canvasRasterOptions(1.0f);
+    RgbaImage image;
+    image.resize(results.canvasWidth, results.canvasHeight);
+    for (int run = 0; run < redrawRuns; ++run) {
+        auto start = Clock::now();
+        rasterizer.render(document, options, image);
+        results.redraw.add(microsecondsSince(start));
+    }
+}
+
+// Bucket fills from random seeds on the rendered canvas, and point hit-tests on the index
+void benchmarkFills(const Document& document, ThreadPool& pool, Results& results) {
+    int width = results.canvasWidth, height = results.canvasHeight;
+    if (width <= 0 || height <= 0) canvasPixelSize(windowWidth, windowHeight, width, height);
+    Rasterizer rasterizer(&pool);
+    RgbaImage image;
+    image.resize(width, height);
+    rasterizer.render(document, canvasRasterOptions(1.0f), image);
+
+    std::mt19937 random(randomSeed + 1);
+    FloodFiller filler;
+    for (int i = 0; i < fillSeeds; ++i) {
+        int x = std::uniform_int_distribution<int>(0, width - 1)(random);
+        int y = std::uniform_int_distribution<int>(0, height - 1)(random);
+        auto start = Clock::now();
+        const std::vector<MaskRun>& runs = filler.fill(image.pixels.data(), width, height, x, y, 32);
+        results.fill.add(microsecondsSince(start));
+        for (const auto& run : runs) results.filledPixels += run.x1 - run.x0;
+    }
+
+    // A single query takes less than a microsecond, so each sample times a batch of them (with
+    // the points drawn beforehand) and records the time per query
+    const int HIT_TEST_BATCH = 1000;
+    std::uniform_real_distribution<float> gridX(SIDEBAR_RIGHT_GL, 1.0f), gridY(DRAWING_AREA_BOTTOM_GL, CANVAS_TOP_GL);
+    std::vector<Point> queries(HIT_TEST_BATCH);
+    std::vector<uint32_t> hits;
+    for (int i = 0; i < fillSeeds; ++i) {
+        for (auto& query : queries) query = Point(gridX(random), gridY(random));
+        auto start = Clock::now();
+        for (const auto& query : queries) document.index.queryPoint(query.x, query.y, hits);
+        results.hitTest.add(microsecondsSince(start) / HIT_TEST_BATCH);
+    }
+}
+
+// Undo latency as the editor sees it: the history step plus redrawing the canvas. Like the
+// editor, the canvas is snapshotted every few strokes (spaced out to fit the snapshot budget);
+// an undo restores the nearest snapshot at or below the new stroke count and draws the strokes
+// after it, a redo draws just the restored stroke. Then a clear and its undo (history only).
+void benchmarkUndo(Document& document, History& history, ThreadPool& pool, Results& results) {
+    struct Checkpoint {
+        size_t strokeCount;
+        std::vector<uint8_t> pixels;
+    };
+    int width, height;
+    canvasPixelSize(windowWidth, windowHeight, width, height);
+    Rasterizer rasterizer(&pool);
+    RasterOptions options = canvasRasterOptions(1.0f);
+    RgbaImage image;
+    image.resize(width, height); // Transparent, like the editor's empty canvas layer
+
+    size_t maxCheckpoints = std::max<size_t>(1, CHECKPOINT_MEMORY_BUDGET / std::max<size_t>(1, image.pixels.size()));
+    size_t interval = std::max(checkpointInterval, document.strokes.size() / maxCheckpoints);
+    std::vector<Checkpoint> checkpoints;
+    checkpoints.push_back({0, image.pixels});
+    for (size_t drawn = 0; drawn < document.strokes.size();) {
+        size_t next = std::min(document.strokes.size(), drawn + interval);
+        rasterizer.drawStrokes(document, drawn, next, options, image);
+        drawn = next;
+        checkpoints.push_back({drawn, image.pixels});
+    }
+    results.checkpoints = checkpoints.size();
+    results.checkpointStrokes = interval;
+
+    size_t steps = std::min(undoSteps, history.undoDepth());
+    for (size_t i = 0; i < steps; ++i) {
+        auto start = Clock::now();
+        history.undo();
+        size_t count = document.strokes.size();
+        while (checkpoints.back().strokeCount > count) checkpoints.pop_back(); // No longer match history
+        image.pixels = checkpoints.back().pixels; // Same size: no allocation
+        rasterizer.drawStrokes(document, checkpoints.back().strokeCount, count, options, image);
+        results.undo.add(microsecondsSince(start));
+    }
+    for (size_t i = 0; i < steps; ++i) {
+        auto start = Clock::now();
+        history.redo();
+        rasterizer.drawStrokes(document, document.strokes.size() - 1, document.strokes.size(), options, image);
+        results.redo.add(microsecondsSince(start));
+    }
+    auto start = Clock::now();
+    history.clear();
+    results.clear.add(microsecondsSince(start));
+    start = Clock::now();
+    history.undo();
+    results.undoClear.add(microsecondsSince(start));
+}
+
+// High-resolution export through the streaming PNG writer, as "Export" in the editor
+void benchmarkExport(const Document& document, ThreadPool& pool, Results& results) {
+    if (exportWidth <= 0) return;
+    int canvasWidth, canvasHeight;
+    canvasPixelSize(windowWidth, windowHeight, canvasWidth, canvasHeight);
+    float scale = exportWidth / static_cast<float>(canvasWidth);
+    results.exportHeight = std::max(1, static_cast<int>(std::lround(canvasHeight * scale)));
+
+    RasterOptions options = canvasRasterOptions(scale);
+    Rasterizer rasterizer(&pool);
+    ImageJob job;
+    job.path = exportPath;
+    job.width = exportWidth;
+    job.height = results.exportHeight;
+    int width = job.width, height = job.height;
+    job.renderRows = [&document, &rasterizer, options, width, height](int firstRow, int rowCount, std::vector<uint8_t>& rgba) {
+        RgbaImage band;
+        band.pixels.swap(rgba);
+        rasterizer.renderRows(document, options, width, height, firstRow, rowCount, band);
+        rgba.swap(band.pixels);
+        return true;
+    };
+    auto start = Clock::now();
+    std::string message;
+    if (!ImageWriter::write(job, message)) {
+        results.exportError = message;
+        return;
+    }
+    results.exportMs = microsecondsSince(start) / 1000.0;
+
+    std::ifstream written(exportPath, std::ios::binary | std::ios::ate);
+    results.exportBytes = written ? static_cast<size_t>(written.tellg()) : 0;
+    written.close();
+    std::remove(exportPath.c_str());
+}
+
+std::string resultsJson(const Results& results, const ThreadPool& pool, const Document& document) {
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"config\": {\"strokes\": " << strokeCount << ", \"points_per_stroke\": " << pointsPerStroke
+         << ", \"min_size\": " << minSize << ", \"max_size\": " << maxSize << ", \"tool_mix\": {";
+    bool first = true;
+    for (int tool = 0; tool <= TOOL_MASK_FILL; ++tool) {
+        if (toolWeights[tool] <= 0.0f) continue;
+        json << (first ? "" : ", ") << jsonString(TOOL_NAMES[tool]) << ": " << toolWeights[tool];
+        first = false;
+    }
+    json << "}, \"seed\": " << randomSeed << ", \"window\": [" << windowWidth << ", " << windowHeight
+         << "], \"reduce\": " << (reduceStrokes ? "true" : "false") << ", \"threads\": " << pool.size() << "},\n";
+    json << "  \"document\": {\"strokes\": " << document.strokes.size() << ", \"raw_points\": " << results.rawPoints
+         << ", \"stored_points\": " << results.storedPoints << ", \"document_bytes\": " << results.documentBytes
+         << ", \"history_bytes\": " << results.historyBytes << ", \"generate_ms\": " << results.generateMs << "},\n";
+    json << "  \"undo_checkpoints\": {\"count\": " << results.checkpoints << ", \"interval\": " << results.checkpointStrokes << "},\n";
+    json << "  \"commit_us\": " << results.commit.json() << ",\n";
+    json << "  \"redraw_us\": " << results.redraw.json() << ",\n";
+    json << "  \"redraw_pixels\": [" << results.canvasWidth << ", " << results.canvasHeight << "],\n";
+    json << "  \"undo_us\": " << results.undo.json() << ",\n";
+    json << "  \"redo_us\": " << results.redo.json() << ",\n";
+    json << "  \"clear_us\": " << results.clear.json() << ",\n";
+    json << "  \"undo_clear_us\": " << results.undoClear.json() << ",\n";
+    json << "  \"fill_us\": " << results.fill.json() << ",\n";
+    json << "  \"fill_pixels\": " << results.filledPixels << ",\n";
+    json << "  \"hit_test_us\": " << results.hitTest.json() << ",\n";
+    json << "  \"export\": {\"width\": " << exportWidth << ", \"height\": " << results.exportHeight
+         << ", \"ms\": " << results.exportMs << ", \"bytes\": " << results.exportBytes;
+    if (!results.exportError.empty()) json << ", \"error\": " << jsonString(results.exportError);
+    json << "},\n";
+    json << "  \"peak_memory_bytes\": " << peakMemoryBytes() << "\n";
+    json << "}\n";
+    return json.str();
+}
+
+// Parses the flags; false on a usage error
+bool parseCommandLine(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--strokes" && hasValue) {
+            strokeCount = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--points" && hasValue) {
+            pointsPerStroke = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--sizes" && hasValue) {
+            if (std::sscanf(argv[++i], "%f-%f", &minSize, &maxSize) != 2 || minSize <= 0.0f || maxSize < minSize) {
+                std::cerr << "Expected --sizes MIN-MAX" << std::endl;
+                return false;
+            }
+        } else if (arg == "--mix" && hasValue) {
+            if (!parseToolMix(argv[++i])) {
+                std::cerr << "Expected --mix TOOL:WEIGHT,... with tools brush, eraser, rect, circle, line, fill, mask" << std::endl;
+                return false;
+            }
+        } else if (arg == "--seed" && hasValue) {
+            randomSeed = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--window" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &windowWidth, &windowHeight) != 2 || windowWidth <= 0 || windowHeight <= 0) {
+                std::cerr << "Expected --window WIDTHxHEIGHT" << std::endl;
+                return false;
+            }
+        } else if (arg == "--no-reduce") {
+            reduceStrokes = false;
+        } else if (arg == "--redraws" && hasValue) {
+            redrawRuns = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--undo" && hasValue) {
+            undoSteps = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--checkpoint-interval" && hasValue) {
+            checkpointInterval = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--fills" && hasValue) {
+            fillSeeds = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--export-width" && hasValue) {
+            exportWidth = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--export-path" && hasValue) {
+            exportPath = argv[++i];
+        } else if (arg == "--jobs" && hasValue) {
+            threadCount = static_cast<unsigned>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void printUsage() {
+    std::cerr << "Usage: sketchmate_bench [options]\n"
+                 "  --strokes N           Strokes in the generated document (default 10000)\n"
+                 "  --points N            Raw samples per freehand stroke (default 200)\n"
+                 "  --sizes MIN-MAX       Stroke sizes in screen pixels (default 2-20)\n"
+                 "  --mix TOOL:W,...      Tool weights: brush, eraser, rect, circle, line, fill, mask\n"
+                 "                        (default brush:70,eraser:10,rect:5,circle:5,line:5,mask:5)\n"
+                 "  --seed N              Random seed (default 1)\n"
+                 "  --window WxH          Window size to simulate (default 1000x700)\n"
+                 "  --no-reduce           Commit raw samples without curve fitting/simplification\n"
+                 "  --redraws N           Full canvas redraws to time (default 3)\n"
+                 "  --undo N              Undo/redo steps to time, including the redraw (default 200)\n"
+                 "  --checkpoint-interval N  Strokes between undo snapshots (default 64)\n"
+                 "  --fills N             Bucket fills and batches of 1000 hit-tests to time (default 50)\n"
+                 "  --export-width PX     Width of the timed PNG export, 0 to skip (default 2000)\n"
+                 "  --export-path FILE    Where the export is written (and removed again)\n"
+                 "  --jobs N              Threads to use (default: one per core)\n"
+                 "  --output FILE         Write the JSON results to FILE instead of stdout\n";
+}
+
+int main(int argc, char** argv) {
+    parseToolMix("brush:70,eraser:10,rect:5,circle:5,line:5,mask:5");
+    if (!parseCommandLine(argc, argv)) {
+        printUsage();
+        return 2;
+    }
+
+    ThreadPool pool(threadCount);
+    Document document;
+    History history(document);
+    Results results;
+
+    std::cerr << "Committing " << strokeCount << " strokes..." << std::endl;
+    benchmarkCommits(document, history, results);
+    results.documentBytes = documentBytes(document);
+    std::cerr << "Redrawing..." << std::endl;
+    benchmarkRedraw(document, pool, results);
+    std::cerr << "Filling..." << std::endl;
+    benchmarkFills(document, pool, results);
+    std::cerr << "Exporting..." << std::endl;
+    benchmarkExport(document, pool, results);
+    std::cerr << "Undoing..." << std::endl;
+    benchmarkUndo(document, history, pool, results);
+    results.historyBytes = history.memoryUsage();
+
+    std::string json = resultsJson(results, pool, document);
+    if (outputPath.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream out(outputPath);
+        out << json;
+        if (!out) {
+            std::cerr << "Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    return results.exportError.empty() ? 0 : 1;
+}
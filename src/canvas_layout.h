@@ -0,0 +1,47 @@
+#pragma once
+#include "raster.h"
+
+// --- Canvas Layout ---
+// Where the drawing area sits in the window's GL square (-1..1 on both axes), shared by the
+// GUI and the headless tools so a document renders the same everywhere. Documents store GL
+// coordinates and stroke sizes in screen pixels, so a render needs the window size too.
+
+// Main Background: Light blue-grey (also what the eraser paints)
+const float BG_R = 0.91f, BG_G = 0.95f, BG_B = 0.96f; // E8F3F7
+
+const int DEFAULT_WINDOW_WIDTH = 1000, DEFAULT_WINDOW_HEIGHT = 700;
+
+// UI Layout Constants (in OpenGL coordinates, from -1.0 to 1.0)
+const float SIDEBAR_WIDTH_GL = 0.20f; // Wider sidebar for better spacing
+const float SIDEBAR_LEFT_GL = -1.0f;
+const float SIDEBAR_RIGHT_GL = -1.0f + SIDEBAR_WIDTH_GL;
+const float PADDING_Y_GL = 0.035f; // Vertical padding
+const float COLOR_SWATCH_SIZE_GL = 0.07f; // Slightly smaller color swatches
+
+// Top Bar Constants
+const float TOP_BAR_HEIGHT_GL = COLOR_SWATCH_SIZE_GL + 2 * PADDING_Y_GL;
+const float CANVAS_TOP_GL = 1.0f - TOP_BAR_HEIGHT_GL;
+
+// Status Bar Constants for defining the drawing area
+const float STATUS_BAR_TEXT_SCALE = 0.003f;
+const float CALCULATED_STATUS_BAR_HEIGHT_GL = (STATUS_BAR_TEXT_SCALE * 1.0f) + PADDING_Y_GL; // Text height + vertical padding for status bar
+const float DRAWING_AREA_BOTTOM_GL = -1.0f + CALCULATED_STATUS_BAR_HEIGHT_GL; // The effective bottom limit for drawing
+
+// Helper: Canvas size in pixels for a window size
+inline void canvasPixelSize(int windowWidth, int windowHeight, int& width, int& height) {
+    width = static_cast<int>((1.0f - SIDEBAR_RIGHT_GL) / 2.0f * windowWidth);
+    height = static_cast<int>((CANVAS_TOP_GL - DRAWING_AREA_BOTTOM_GL) / 2.0f * windowHeight);
+}
+
+// Raster options that map the canvas area onto an image, drawn as on screen (white canvas,
+// eraser painting the background color). `sizeScale` is image pixels per screen pixel.
+inline RasterOptions canvasRasterOptions(float sizeScale) {
+    RasterOptions options;
+    options.left = SIDEBAR_RIGHT_GL;
+    options.right = 1.0f;
+    options.bottom = DRAWING_AREA_BOTTOM_GL;
+    options.top = CANVAS_TOP_GL;
+    options.sizeScale = sizeScale;
+    options.eraserColor[0] = BG_R; options.eraserColor[1] = BG_G; options.eraserColor[2] = BG_B;
+    return options;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// CRC-32 (IEEE 802.3, as used by PNG chunks and the stroke journal). Pass the previous
+// result as `crc` to continue a running checksum; start with 0.
+inline uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] { // Thread-safe one-time init
+        std::array<uint32_t, 256> entries;
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
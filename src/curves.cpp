@@ -0,0 +1,209 @@
+#include "curves.h"
+#include <cmath>
+#include <algorithm>
+
+// --- Vector helpers (pixel space) ---
+
+static Point add(const Point& a, const Point& b) { return Point(a.x + b.x, a.y + b.y); }
+static Point sub(const Point& a, const Point& b) { return Point(a.x - b.x, a.y - b.y); }
+static Point mul(const Point& a, float s) { return Point(a.x * s, a.y * s); }
+static float dot(const Point& a, const Point& b) { return a.x * b.x + a.y * b.y; }
+static float length(const Point& a) { return std::sqrt(dot(a, a)); }
+static bool isFinite(const Point& a) { return std::isfinite(a.x) && std::isfinite(a.y); }
+
+static Point normalize(const Point& a) {
+    float len = length(a);
+    return len > 0.0f ? mul(a, 1.0f / len) : Point(0.0f, 0.0f);
+}
+
+static Point bezierPoint(const Point& p0, const Point& c0, const Point& c1, const Point& p1, float t) {
+    float mt = 1.0f - t;
+    float b0 = mt * mt * mt, b1 = 3.0f * t * mt * mt, b2 = 3.0f * t * t * mt, b3 = t * t * t;
+    return Point(b0 * p0.x + b1 * c0.x + b2 * c1.x + b3 * p1.x,
+                 b0 * p0.y + b1 * c0.y + b2 * c1.y + b3 * p1.y);
+}
+
+// Helper: Squared distance from p to the segment a-b
+static float segmentDistanceSq(const Point& p, const Point& a, const Point& b) {
+    Point ab = sub(b, a), ap = sub(p, a);
+    float lengthSq = dot(ab, ab);
+    float t = lengthSq > 0.0f ? std::max(0.0f, std::min(1.0f, dot(ap, ab) / lengthSq)) : 0.0f;
+    Point d = sub(ap, mul(ab, t));
+    return dot(d, d);
+}
+
+// --- Fitting ---
+
+bool CurveFitter::fit(PointArena& arena, FreehandRef& stroke, float tolerancePx, const CurveScale& scale) {
+    if (stroke.bezier || stroke.count < 3) return false;
+
+    samples_.clear();
+    arena.forEachSpan(stroke, [this, &scale](const Point* points, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+            Point p(points[i].x * scale.pixelsPerUnitX, points[i].y * scale.pixelsPerUnitY);
+            if (samples_.empty() || p.x != samples_.back().x || p.y != samples_.back().y) {
+                samples_.push_back(p);
+            }
+        }
+    });
+    if (samples_.size() < 2) return false;
+
+    uint32_t last = static_cast<uint32_t>(samples_.size() - 1);
+    controls_.clear();
+    pending_.clear();
+    pending_.push_back({0, last, normalize(sub(samples_[1], samples_[0])),
+                        normalize(sub(samples_[last - 1], samples_[last]))});
+    float toleranceSq = tolerancePx * tolerancePx;
+    while (!pending_.empty()) {
+        Span span = pending_.back();
+        pending_.pop_back();
+        fitSpan(span, toleranceSq);
+        if (controls_.size() >= stroke.count) return false; // Already no smaller than the samples
+    }
+
+    for (auto& control : controls_) {
+        control = Point(control.x / scale.pixelsPerUnitX, control.y / scale.pixelsPerUnitY);
+    }
+    arena.overwrite(stroke, controls_.data(), static_cast<uint32_t>(controls_.size()));
+    stroke.bezier = 1;
+    return true;
+}
+
+void CurveFitter::emitSegment(const Point& p0, const Point& c0, const Point& c1, const Point& p1) {
+    if (controls_.empty()) controls_.push_back(p0);
+    controls_.push_back(c0);
+    controls_.push_back(c1);
+    controls_.push_back(p1);
+}
+
+// Fits one cubic to samples [first, last]; if it misses by more than the tolerance, the span is
+// split at the worst sample and both halves are queued (left half on top, so output stays in order).
+void CurveFitter::fitSpan(const Span& span, float toleranceSq) {
+    const Point& p0 = samples_[span.first];
+    const Point& p1 = samples_[span.last];
+    float chord = length(sub(p1, p0));
+
+    if (span.last - span.first == 1) {
+        float d = chord / 3.0f;
+        emitSegment(p0, add(p0, mul(span.leftTangent, d)), add(p1, mul(span.rightTangent, d)), p1);
+        return;
+    }
+
+    // Chord-length parameterization
+    params_.assign(1, 0.0f);
+    for (uint32_t i = span.first + 1; i <= span.last; ++i) {
+        params_.push_back(params_.back() + length(sub(samples_[i], samples_[i - 1])));
+    }
+    float total = params_.back();
+    for (auto& u : params_) u = total > 0.0f ? u / total : 0.0f;
+
+    Point c0, c1;
+    float maxErrorSq = 0.0f;
+    uint32_t split = span.first + (span.last - span.first) / 2;
+    for (int iteration = 0; iteration < 5; ++iteration) {
+        // Least-squares tangent lengths for fixed endpoints and tangent directions
+        float m00 = 0, m01 = 0, m11 = 0, x0 = 0, x1 = 0;
+        for (uint32_t i = span.first; i <= span.last; ++i) {
+            float u = params_[i - span.first], mu = 1.0f - u;
+            Point a0 = mul(span.leftTangent, 3.0f * u * mu * mu);
+            Point a1 = mul(span.rightTangent, 3.0f * u * u * mu);
+            Point rest = sub(samples_[i], bezierPoint(p0, p0, p1, p1, u));
+            m00 += dot(a0, a0); m01 += dot(a0, a1); m11 += dot(a1, a1);
+            x0 += dot(a0, rest); x1 += dot(a1, rest);
+        }
+        float det = m00 * m11 - m01 * m01;
+        float alphaLeft = det != 0.0f ? (x0 * m11 - x1 * m01) / det : 0.0f;
+        float alphaRight = det != 0.0f ? (m00 * x1 - m01 * x0) / det : 0.0f;
+        float epsilon = 1e-6f * chord;
+        if (alphaLeft < epsilon || alphaRight < epsilon) { // Degenerate fit: fall back to a third of the chord
+            alphaLeft = alphaRight = chord / 3.0f;
+        }
+        c0 = add(p0, mul(span.leftTangent, alphaLeft));
+        c1 = add(p1, mul(span.rightTangent, alphaRight));
+
+        maxErrorSq = 0.0f;
+        for (uint32_t i = span.first + 1; i < span.last; ++i) {
+            Point d = sub(bezierPoint(p0, c0, c1, p1, params_[i - span.first]), samples_[i]);
+            if (dot(d, d) > maxErrorSq) {
+                maxErrorSq = dot(d, d);
+                split = i;
+            }
+        }
+        if (maxErrorSq <= toleranceSq) {
+            emitSegment(p0, c0, c1, p1);
+            return;
+        }
+        if (maxErrorSq > toleranceSq * 16.0f) break; // Too far off for reparameterization to rescue
+
+        // One Newton-Raphson step per sample towards its closest point on the curve
+        for (uint32_t i = span.first + 1; i < span.last; ++i) {
+            float& u = params_[i - span.first];
+            float mu = 1.0f - u;
+            Point q = sub(bezierPoint(p0, c0, c1, p1, u), samples_[i]);
+            Point d1 = add(add(mul(sub(c0, p0), 3.0f * mu * mu), mul(sub(c1, c0), 6.0f * u * mu)),
+                           mul(sub(p1, c1), 3.0f * u * u));
+            Point d2 = add(mul(add(sub(c1, mul(c0, 2.0f)), p0), 6.0f * mu),
+                           mul(add(sub(p1, mul(c1, 2.0f)), c0), 6.0f * u));
+            float denominator = dot(d1, d1) + dot(q, d2);
+            if (denominator != 0.0f) u = std::max(0.0f, std::min(1.0f, u - dot(q, d1) / denominator));
+        }
+    }
+
+    Point centerTangent = normalize(sub(samples_[split - 1], samples_[split + 1]));
+    if (centerTangent.x == 0.0f && centerTangent.y == 0.0f) { // Stroke doubled back on itself
+        centerTangent = normalize(sub(samples_[split - 1], samples_[split]));
+    }
+    pending_.push_back({split, span.last, mul(centerTangent, -1.0f), span.rightTangent});
+    pending_.push_back({span.first, split, span.leftTangent, centerTangent});
+}
+
+// --- Flattening ---
+
+const std::vector<Point>& CurveFlattener::flatten(const PointArena& arena, const FreehandRef& stroke,
+                                                  float tolerancePx, float maxSegmentPx, const CurveScale& scale) {
+    controls_.clear();
+    arena.forEachSpan(stroke, [this, &scale](const Point* points, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+            controls_.push_back(Point(points[i].x * scale.pixelsPerUnitX, points[i].y * scale.pixelsPerUnitY));
+        }
+    });
+
+    output_.clear();
+    if (controls_.empty()) return output_;
+    output_.push_back(controls_[0]);
+
+    float toleranceSq = tolerancePx * tolerancePx;
+    float maxSegmentSq = maxSegmentPx * maxSegmentPx;
+    for (size_t i = 0; i + 3 < controls_.size(); i += 3) {
+        stack_.clear();
+        stack_.push_back({controls_[i], controls_[i + 1], controls_[i + 2], controls_[i + 3], 0});
+        while (!stack_.empty()) {
+            Piece piece = stack_.back();
+            stack_.pop_back();
+            Point chord = sub(piece.p1, piece.p0);
+            bool flat = segmentDistanceSq(piece.c0, piece.p0, piece.p1) <= toleranceSq &&
+                        segmentDistanceSq(piece.c1, piece.p0, piece.p1) <= toleranceSq;
+            // A damaged file can hold NaN/Inf or huge control points, which never test flat:
+            // those pieces are drawn as their chord instead of being split forever
+            if ((flat && (maxSegmentPx <= 0.0f || dot(chord, chord) <= maxSegmentSq)) || piece.depth >= MAX_DEPTH ||
+                !(isFinite(piece.p0) && isFinite(piece.c0) && isFinite(piece.c1) && isFinite(piece.p1))) {
+                output_.push_back(piece.p1);
+                continue;
+            }
+            // de Casteljau split at t = 0.5; the left half is pushed last so it is emitted first
+            Point ab = mul(add(piece.p0, piece.c0), 0.5f);
+            Point bc = mul(add(piece.c0, piece.c1), 0.5f);
+            Point cd = mul(add(piece.c1, piece.p1), 0.5f);
+            Point abc = mul(add(ab, bc), 0.5f);
+            Point bcd = mul(add(bc, cd), 0.5f);
+            Point mid = mul(add(abc, bcd), 0.5f);
+            stack_.push_back({mid, bcd, cd, piece.p1, piece.depth + 1});
+            stack_.push_back({piece.p0, ab, abc, mid, piece.depth + 1});
+        }
+    }
+
+    for (auto& point : output_) {
+        point = Point(point.x / scale.pixelsPerUnitX, point.y / scale.pixelsPerUnitY);
+    }
+    return output_;
+}
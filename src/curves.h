@@ -0,0 +1,53 @@
+#pragma once
+#include "document.h"
+#include <vector>
+#include <cstdint>
+
+// --- Curve-Fitted Strokes ---
+// Committed freehand strokes can be stored as piecewise cubic Beziers instead of raw samples.
+// CurveFitter replaces a stroke's samples with control points (Schneider's least-squares fit,
+// "An Algorithm for Automatically Fitting Digitized Curves", Graphics Gems 1990), and
+// CurveFlattener turns them back into a polyline for whatever scale the stroke is drawn at.
+// Control points are laid out as P0, C0a, C0b, P1, C1a, C1b, P2, ... (3n + 1 points).
+
+struct CurveScale {
+    float pixelsPerUnitX = 1.0f; // Output pixels per GL unit
+    float pixelsPerUnitY = 1.0f;
+};
+
+class CurveFitter {
+public:
+    // Fits the stroke's samples to within `tolerancePx` and stores the control points in place
+    // of the samples. Returns false (leaving the stroke untouched) when the fit would not be
+    // smaller than the samples it replaces.
+    bool fit(PointArena& arena, FreehandRef& stroke, float tolerancePx, const CurveScale& scale);
+
+private:
+    struct Span { uint32_t first, last; Point leftTangent, rightTangent; };
+
+    void fitSpan(const Span& span, float toleranceSq);
+    void emitSegment(const Point& p0, const Point& c0, const Point& c1, const Point& p1);
+
+    std::vector<Point> samples_; // Pixel space, consecutive duplicates removed
+    std::vector<float> params_; // Curve parameter assigned to each sample of the current span
+    std::vector<Span> pending_; // Spans still to fit, last one first
+    std::vector<Point> controls_; // Output, pixel space
+};
+
+class CurveFlattener {
+public:
+    // Flattens a Bezier stroke into a polyline (GL coordinates) whose segments deviate by at most
+    // `tolerancePx` from the curve and are no longer than `maxSegmentPx`.
+    const std::vector<Point>& flatten(const PointArena& arena, const FreehandRef& stroke,
+                                      float tolerancePx, float maxSegmentPx, const CurveScale& scale);
+
+private:
+    // Subdivision stops here (up to 65536 segments per piece) even if a piece is not flat yet
+    static const int MAX_DEPTH = 16;
+
+    struct Piece { Point p0, c0, c1, p1; int depth; };
+
+    std::vector<Point> controls_;
+    std::vector<Piece> stack_;
+    std::vector<Point> output_;
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "point_arena.h"
+#include "spatial_index.h"
+
+// --- Drawing Data ---
+
+// A canvas position in GL coordinates (-1..1). Color and size live on the stroke.
+struct Point {
+    float x, y;
+    Point(float x_coord = 0, float y_coord = 0) : x(x_coord), y(y_coord) {}
+};
+
+// A canvas position quantized to 16 bits per axis (4 bytes instead of 8)
+struct PackedPoint {
+    int16_t x, y;
+};
+
+const float PACKED_POINT_SCALE = 32767.0f; // GL coordinate 1.0 maps to this value
+
+inline int16_t packCoord(float v) {
+    float scaled = std::max(-1.0f, std::min(1.0f, v)) * PACKED_POINT_SCALE;
+    return static_cast<int16_t>(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+inline PackedPoint packPoint(const Point& p) {
+    return {packCoord(p.x), packCoord(p.y)};
+}
+
+inline Point unpackPoint(const PackedPoint& p) {
+    return Point(p.x / PACKED_POINT_SCALE, p.y / PACKED_POINT_SCALE);
+}
+
+// --- Stroke Kinds ---
+// A stroke is a small tagged union keyed by its tool. Analytic shapes are stored inline;
+// freehand strokes (brush/eraser) reference a chain of blocks in the document's point arena.
+// Strokes never own heap memory, so they are cheap to copy, move and store contiguously.
+
+enum StrokeTool {
+    TOOL_BRUSH = 0,
+    TOOL_ERASER = 1,
+    TOOL_RECTANGLE = 2,
+    TOOL_CIRCLE = 3,
+    TOOL_LINE = 4,
+    TOOL_FILL = 5,
+    TOOL_MASK_FILL = 6 // Bucket fill: a run-length mask of canvas pixels
+};
+
+struct RectShape {
+    Point start, end; // Opposite corners as dragged (outline)
+};
+
+struct CircleShape {
+    Point center;
+    float radius;
+};
+
+struct LineShape {
+    Point start, end;
+};
+
+// Filled area: a disc when radius > 0, otherwise the rectangle [min, max]
+struct FillShape {
+    Point min, max;
+    Point center;
+    float radius;
+};
+
+// Pixels covered by a bucket fill, as runs along rows. Rows count up from the bottom of the mask.
+struct MaskRun {
+    uint16_t y;
+    uint16_t x0, x1; // Pixels [x0, x1)
+};
+
+// A bucket fill's mask, stored in the document's MaskPool, and where its pixels lie in GL space
+struct MaskShape {
+    uint32_t mask; // Id in Document::masks
+    uint32_t runCount;
+    Point origin; // GL position of the mask's bottom-left pixel corner
+    float pixelWidth, pixelHeight; // Size of one mask pixel in GL units
+};
+
+struct Stroke {
+    int tool; // StrokeTool: selects the active member of the union below
+    float size; // Size for brush/eraser/outline thickness
+    float color[3]; // Stroke color (fill color for the fill tool)
+    union {
+        FreehandRef freehand; // TOOL_BRUSH, TOOL_ERASER
+        RectShape rect;       // TOOL_RECTANGLE
+        CircleShape circle;   // TOOL_CIRCLE
+        LineShape line;       // TOOL_LINE
+        FillShape fill;       // TOOL_FILL
+        MaskShape mask;       // TOOL_MASK_FILL
+    };
+
+    Stroke() : tool(TOOL_BRUSH), size(1.0f), color{0, 0, 0}, fill() {}
+};
+
+inline bool isFreehandTool(int tool) {
+    return tool == TOOL_BRUSH || tool == TOOL_ERASER;
+}
+
+// Filled areas are drawn as triangles in the stroke color, without dabs or outlines
+inline bool isFillTool(int tool) {
+    return tool == TOOL_FILL || tool == TOOL_MASK_FILL;
+}
+
+// Run lists of bucket fills. Like arena chains, a mask is shared by every copy of its stroke
+// (live, undone or cleared) and released once none of them can come back.
+class MaskPool {
+public:
+    uint32_t add(std::vector<MaskRun>&& runs) {
+        uint32_t id;
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+            masks_[id] = std::move(runs);
+        } else {
+            id = static_cast<uint32_t>(masks_.size());
+            masks_.push_back(std::move(runs));
+        }
+        return id;
+    }
+    void release(uint32_t id) {
+        masks_[id] = std::vector<MaskRun>();
+        free_.push_back(id);
+    }
+    const std::vector<MaskRun>& runs(uint32_t id) const { return masks_[id]; }
+    size_t bytes() const {
+        size_t total = masks_.capacity() * sizeof(std::vector<MaskRun>) + free_.capacity() * sizeof(uint32_t);
+        for (const auto& mask : masks_) total += mask.capacity() * sizeof(MaskRun);
+        return total;
+    }
+
+private:
+    std::vector<std::vector<MaskRun>> masks_;
+    std::vector<uint32_t> free_;
+};
+
+// A drawing: the ordered list of committed strokes plus the arena holding freehand points.
+// The arena lives as long as the document and is shared by the strokes in history, so a
+// chain stays valid while any stroke (live, undone or cleared) still references it.
+// `index` holds each stroke's bounds and is kept in step with `strokes` by History.
+struct Document {
+    std::vector<Stroke> strokes;
+    PointArena arena;
+    size_t strokeBlocks = 0; // Arena blocks referenced by `strokes`
+    SpatialIndex index;
+    MaskPool masks; // Runs of TOOL_MASK_FILL strokes
+};
+
+// Helper: Arena blocks a stroke's points occupy
+inline size_t strokeBlockCount(const Stroke& stroke) {
+    return isFreehandTool(stroke.tool) ? PointArena::blocksFor(stroke.freehand.count) : 0;
+}
+
+// Calls fn(const Point* points, uint32_t n) for each contiguous run of a freehand stroke
+template <typename Fn>
+inline void forEachStrokeSpan(const Document& document, const Stroke& stroke, Fn&& fn) {
+    document.arena.forEachSpan(stroke.freehand, fn);
+}
+
+// Geometric bounds of a stroke in GL coordinates, not counting its thickness.
+// Curve strokes use their control points, which always enclose the curve.
+inline Bounds strokeBounds(const Document& document, const Stroke& stroke) {
+    switch (stroke.tool) {
+        case TOOL_BRUSH:
+        case TOOL_ERASER: {
+            Bounds box = {1e30f, 1e30f, -1e30f, -1e30f};
+            forEachStrokeSpan(document, stroke, [&box](const Point* points, uint32_t n) {
+                for (uint32_t i = 0; i < n; ++i) {
+                    box.minX = std::min(box.minX, points[i].x); box.maxX = std::max(box.maxX, points[i].x);
+                    box.minY = std::min(box.minY, points[i].y); box.maxY = std::max(box.maxY, points[i].y);
+                }
+            });
+            return box;
+        }
+        case TOOL_RECTANGLE:
+            return {std::min(stroke.rect.start.x, stroke.rect.end.x), std::min(stroke.rect.start.y, stroke.rect.end.y),
+                    std::max(stroke.rect.start.x, stroke.rect.end.x), std::max(stroke.rect.start.y, stroke.rect.end.y)};
+        case TOOL_CIRCLE:
+            return {stroke.circle.center.x - stroke.circle.radius, stroke.circle.center.y - stroke.circle.radius,
+                    stroke.circle.center.x + stroke.circle.radius, stroke.circle.center.y + stroke.circle.radius};
+        case TOOL_LINE:
+            return {std::min(stroke.line.start.x, stroke.line.end.x), std::min(stroke.line.start.y, stroke.line.end.y),
+                    std::max(stroke.line.start.x, stroke.line.end.x), std::max(stroke.line.start.y, stroke.line.end.y)};
+        case TOOL_FILL:
+            if (stroke.fill.radius > 0) {
+                return {stroke.fill.center.x - stroke.fill.radius, stroke.fill.center.y - stroke.fill.radius,
+                        stroke.fill.center.x + stroke.fill.radius, stroke.fill.center.y + stroke.fill.radius};
+            }
+            return {stroke.fill.min.x, stroke.fill.min.y, stroke.fill.max.x, stroke.fill.max.y};
+        case TOOL_MASK_FILL: {
+            const std::vector<MaskRun>& runs = document.masks.runs(stroke.mask.mask);
+            if (runs.empty()) return {stroke.mask.origin.x, stroke.mask.origin.y, stroke.mask.origin.x, stroke.mask.origin.y};
+            int minY = runs.front().y, maxY = runs.front().y, minX = runs.front().x0, maxX = runs.front().x1;
+            for (const auto& run : runs) {
+                minY = std::min<int>(minY, run.y); maxY = std::max<int>(maxY, run.y);
+                minX = std::min<int>(minX, run.x0); maxX = std::max<int>(maxX, run.x1);
+            }
+            return {stroke.mask.origin.x + minX * stroke.mask.pixelWidth, stroke.mask.origin.y + minY * stroke.mask.pixelHeight,
+                    stroke.mask.origin.x + maxX * stroke.mask.pixelWidth, stroke.mask.origin.y + (maxY + 1) * stroke.mask.pixelHeight};
+        }
+    }
+    return {0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+// Rough heap footprint of a document's live content (stroke records, their point blocks and bounds)
+inline size_t documentBytes(const Document& document) {
+    return document.strokes.capacity() * sizeof(Stroke)
+         + document.strokeBlocks * PointArena::BLOCK_POINTS * sizeof(Point)
+         + document.index.bytes()
+         + document.masks.bytes();
+}
+
+// Empties a document completely, including every arena chain and mask (history must be reset too)
+inline void resetDocument(Document& document) {
+    std::vector<Stroke>().swap(document.strokes);
+    document.arena.reset();
+    document.strokeBlocks = 0;
+    document.index.clear();
+    document.masks = MaskPool();
+}
+
+// Deep copy of the committed strokes into an empty document, for work that must not see later
+// edits (e.g. an export rendered on another thread). Each chain is copied into one contiguous run.
+inline void copyDocument(const Document& source, Document& copy) {
+    copy.strokes.reserve(source.strokes.size());
+    for (const Stroke& stroke : source.strokes) {
+        Stroke copied = stroke;
+        if (isFreehandTool(stroke.tool)) {
+            copied.freehand = PointArena::emptyRef();
+            source.arena.forEachSpan(stroke.freehand, [&copy, &copied](const Point* points, uint32_t n) {
+                for (uint32_t i = 0; i < n; ++i) copy.arena.append(copied.freehand, points[i]);
+            });
+            copied.freehand.bezier = stroke.freehand.bezier;
+            copy.strokeBlocks += strokeBlockCount(copied);
+        } else if (stroke.tool == TOOL_MASK_FILL) {
+            copied.mask.mask = copy.masks.add(std::vector<MaskRun>(source.masks.runs(stroke.mask.mask)));
+        }
+        copy.strokes.push_back(copied);
+    }
+    copy.index = source.index; // Same strokes, same bounds
+}
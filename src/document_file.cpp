@@ -0,0 +1,393 @@
+#include "document_file.h"
+#include "stroke_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// --- On-disk records ---
+
+static const char SMK_MAGIC[4] = {'S', 'M', 'K', '\x1A'};
+
+struct SmkHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t chunkCount;
+    uint32_t reserved;
+};
+static_assert(sizeof(SmkHeader) == 16, "SmkHeader layout");
+
+struct SmkChunkHeader {
+    char type[4];
+    uint32_t reserved;
+    uint64_t size; // Payload bytes, excluding padding
+};
+static_assert(sizeof(SmkChunkHeader) == 16, "SmkChunkHeader layout");
+
+// Helper: Bytes of padding after a payload to reach 8-byte alignment
+static size_t paddingFor(uint64_t size) {
+    return static_cast<size_t>((8 - size % 8) % 8);
+}
+
+// --- Stroke records ---
+
+void packStroke(const Document& document, const Stroke& stroke, const Bounds& bounds, SmkStrokeRecord& record) {
+    std::memset(&record, 0, sizeof(record));
+    record.tool = static_cast<uint32_t>(stroke.tool);
+    record.size = stroke.size;
+    std::memcpy(record.color, stroke.color, sizeof(record.color));
+    record.bounds[0] = bounds.minX; record.bounds[1] = bounds.minY;
+    record.bounds[2] = bounds.maxX; record.bounds[3] = bounds.maxY;
+    switch (stroke.tool) {
+        case TOOL_RECTANGLE: {
+            const float shape[4] = {stroke.rect.start.x, stroke.rect.start.y, stroke.rect.end.x, stroke.rect.end.y};
+            std::memcpy(record.shape, shape, sizeof(shape));
+            break;
+        }
+        case TOOL_CIRCLE: {
+            const float shape[3] = {stroke.circle.center.x, stroke.circle.center.y, stroke.circle.radius};
+            std::memcpy(record.shape, shape, sizeof(shape));
+            break;
+        }
+        case TOOL_LINE: {
+            const float shape[4] = {stroke.line.start.x, stroke.line.start.y, stroke.line.end.x, stroke.line.end.y};
+            std::memcpy(record.shape, shape, sizeof(shape));
+            break;
+        }
+        case TOOL_FILL: {
+            const float shape[7] = {stroke.fill.min.x, stroke.fill.min.y, stroke.fill.max.x, stroke.fill.max.y,
+                                    stroke.fill.center.x, stroke.fill.center.y, stroke.fill.radius};
+            std::memcpy(record.shape, shape, sizeof(shape));
+            break;
+        }
+        case TOOL_MASK_FILL:
+            record.range.count = static_cast<uint32_t>(document.masks.runs(stroke.mask.mask).size());
+            record.range.origin[0] = stroke.mask.origin.x;
+            record.range.origin[1] = stroke.mask.origin.y;
+            record.range.pixelSize[0] = stroke.mask.pixelWidth;
+            record.range.pixelSize[1] = stroke.mask.pixelHeight;
+            break;
+        default: // Freehand
+            record.range.count = stroke.freehand.count;
+            record.flags = stroke.freehand.bezier ? SMK_FLAG_BEZIER : 0;
+            break;
+    }
+}
+
+Stroke unpackStroke(const SmkStrokeRecord& record) {
+    Stroke stroke;
+    stroke.tool = static_cast<int>(record.tool);
+    stroke.size = record.size;
+    std::memcpy(stroke.color, record.color, sizeof(stroke.color));
+    const float* shape = record.shape;
+    switch (stroke.tool) {
+        case TOOL_RECTANGLE:
+            stroke.rect.start = Point(shape[0], shape[1]);
+            stroke.rect.end = Point(shape[2], shape[3]);
+            break;
+        case TOOL_CIRCLE:
+            stroke.circle.center = Point(shape[0], shape[1]);
+            stroke.circle.radius = shape[2];
+            break;
+        case TOOL_LINE:
+            stroke.line.start = Point(shape[0], shape[1]);
+            stroke.line.end = Point(shape[2], shape[3]);
+            break;
+        case TOOL_FILL:
+            stroke.fill.min = Point(shape[0], shape[1]);
+            stroke.fill.max = Point(shape[2], shape[3]);
+            stroke.fill.center = Point(shape[4], shape[5]);
+            stroke.fill.radius = shape[6];
+            break;
+        case TOOL_MASK_FILL:
+            stroke.mask.mask = 0;
+            stroke.mask.runCount = record.range.count;
+            stroke.mask.origin = Point(record.range.origin[0], record.range.origin[1]);
+            stroke.mask.pixelWidth = record.range.pixelSize[0];
+            stroke.mask.pixelHeight = record.range.pixelSize[1];
+            break;
+        default: // Freehand
+            stroke.freehand = PointArena::emptyRef();
+            stroke.freehand.bezier = (record.flags & SMK_FLAG_BEZIER) ? 1 : 0;
+            break;
+    }
+    return stroke;
+}
+
+bool hasFiniteBounds(const SmkStrokeRecord& record) {
+    for (float v : record.bounds) {
+        if (!std::isfinite(v)) return false;
+    }
+    return true;
+}
+
+// --- Saving ---
+
+bool syncFile(FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool saveDocument(const Document& document, const std::string& path, std::string& error, const SaveOptions& options) {
+    uint64_t pointCount = 0, runCount = 0;
+    std::vector<uint8_t> encoded; // PNTZ payload...
+    std::vector<uint64_t> encodedOffsets; // ...and where each freehand stroke starts in it
+    for (const auto& stroke : document.strokes) {
+        if (isFreehandTool(stroke.tool)) {
+            pointCount += stroke.freehand.count;
+            if (options.compressPoints) {
+                encodedOffsets.push_back(encoded.size());
+                encodePoints(document.arena, stroke.freehand, encoded);
+            }
+        }
+        if (stroke.tool == TOOL_MASK_FILL) runCount += document.masks.runs(stroke.mask.mask).size();
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        error = "cannot create " + temporaryPath;
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    bool ok = true;
+    auto put = [&ok, file](const void* data, size_t size) {
+        ok = ok && (size == 0 || std::fwrite(data, 1, size, file) == size);
+    };
+    auto beginChunk = [&put](const char type[4], uint64_t size) {
+        SmkChunkHeader chunk;
+        std::memcpy(chunk.type, type, 4);
+        chunk.reserved = 0;
+        chunk.size = size;
+        put(&chunk, sizeof(chunk));
+    };
+    auto endChunk = [&put](uint64_t size) {
+        static const uint8_t zeros[8] = {};
+        put(zeros, paddingFor(size));
+    };
+
+    SmkHeader header;
+    std::memcpy(header.magic, SMK_MAGIC, 4);
+    header.version = options.compressPoints ? 2 : 1; // Uncompressed files stay readable by older builds
+    header.headerSize = sizeof(SmkHeader);
+    header.chunkCount = options.journalGeneration != 0 ? 4 : 3;
+    header.reserved = 0;
+    put(&header, sizeof(header));
+
+    // Stroke table, with each freehand stroke/fill pointing at its slice of PNTS/RUNS
+    uint64_t strokeCount = document.strokes.size();
+    uint64_t tableSize = sizeof(uint64_t) + strokeCount * sizeof(SmkStrokeRecord);
+    beginChunk("STRK", tableSize);
+    put(&strokeCount, sizeof(strokeCount));
+    uint64_t nextPoint = 0, nextRun = 0;
+    size_t nextEncoded = 0;
+    for (size_t i = 0; i < document.strokes.size(); ++i) {
+        const Stroke& stroke = document.strokes[i];
+        Bounds bounds = document.index.size() == document.strokes.size() ? document.index.bounds(static_cast<uint32_t>(i))
+                                                                           : strokeBounds(document, stroke);
+        SmkStrokeRecord record;
+        packStroke(document, stroke, bounds, record);
+        if (isFreehandTool(stroke.tool) && options.compressPoints) {
+            record.range.first = encodedOffsets[nextEncoded++];
+            record.flags |= SMK_FLAG_ENCODED;
+        } else if (isFreehandTool(stroke.tool)) {
+            record.range.first = nextPoint;
+            nextPoint += record.range.count;
+        } else if (stroke.tool == TOOL_MASK_FILL) {
+            record.range.first = nextRun;
+            nextRun += record.range.count;
+        }
+        put(&record, sizeof(record));
+    }
+    endChunk(tableSize);
+
+    if (options.compressPoints) {
+        beginChunk("PNTZ", encoded.size());
+        put(encoded.data(), encoded.size());
+        endChunk(encoded.size());
+    } else {
+        beginChunk("PNTS", pointCount * sizeof(Point));
+        for (const auto& stroke : document.strokes) {
+            if (!isFreehandTool(stroke.tool)) continue;
+            document.arena.forEachSpan(stroke.freehand, [&put](const Point* points, uint32_t n) {
+                put(points, n * sizeof(Point));
+            });
+        }
+        endChunk(pointCount * sizeof(Point));
+    }
+
+    beginChunk("RUNS", runCount * sizeof(MaskRun));
+    for (const auto& stroke : document.strokes) {
+        if (stroke.tool != TOOL_MASK_FILL) continue;
+        const std::vector<MaskRun>& runs = document.masks.runs(stroke.mask.mask);
+        put(runs.data(), runs.size() * sizeof(MaskRun));
+    }
+    endChunk(runCount * sizeof(MaskRun));
+
+    if (options.journalGeneration != 0) {
+        beginChunk("JGEN", sizeof(options.journalGeneration));
+        put(&options.journalGeneration, sizeof(options.journalGeneration));
+    }
+
+    ok = ok && syncFile(file); // On disk before it can replace the old file
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::remove(temporaryPath.c_str());
+        error = "cannot write " + temporaryPath;
+        return false;
+    }
+#ifdef _WIN32
+    ok = MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok) {
+        std::remove(temporaryPath.c_str());
+        error = "cannot replace " + path;
+    }
+    return ok;
+}
+
+// --- Loading ---
+
+bool DocumentFile::open(const std::string& path, std::string& error) {
+    *this = DocumentFile();
+    std::shared_ptr<MappedFile> file = MappedFile::open(path, error);
+    if (!file) return false;
+
+    const uint8_t* data = file->data();
+    const size_t size = file->size();
+    SmkHeader header;
+    if (size < sizeof(header)) {
+        error = path + " is not a SketchMate document";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, SMK_MAGIC, 4) != 0 || header.headerSize < sizeof(header) || header.headerSize > size ||
+        header.headerSize % 8 != 0) {
+        error = path + " is not a SketchMate document";
+        return false;
+    }
+    if (header.version > VERSION) {
+        error = path + " was saved by a newer version (format " + std::to_string(header.version) + ")";
+        return false;
+    }
+
+    bool haveStrokes = false;
+    size_t offset = header.headerSize;
+    for (uint32_t c = 0; c < header.chunkCount; ++c) {
+        SmkChunkHeader chunk;
+        if (size - offset < sizeof(chunk)) break;
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk.size > size - offset) {
+            error = path + " is truncated";
+            return false;
+        }
+        const uint8_t* payload = data + offset;
+        if (std::memcmp(chunk.type, "STRK", 4) == 0 && chunk.size >= sizeof(uint64_t)) {
+            std::memcpy(&strokeCount_, payload, sizeof(uint64_t));
+            if (strokeCount_ > (chunk.size - sizeof(uint64_t)) / sizeof(SmkStrokeRecord)) {
+                error = path + " has a damaged stroke table";
+                return false;
+            }
+            strokes_ = reinterpret_cast<const SmkStrokeRecord*>(payload + sizeof(uint64_t));
+            haveStrokes = true;
+        } else if (std::memcmp(chunk.type, "PNTS", 4) == 0) {
+            points_ = reinterpret_cast<const Point*>(payload);
+            pointCount_ = chunk.size / sizeof(Point);
+        } else if (std::memcmp(chunk.type, "PNTZ", 4) == 0) {
+            encoded_ = payload;
+            encodedSize_ = chunk.size;
+        } else if (std::memcmp(chunk.type, "RUNS", 4) == 0) {
+            runs_ = reinterpret_cast<const MaskRun*>(payload);
+            runCount_ = chunk.size / sizeof(MaskRun);
+        } else if (std::memcmp(chunk.type, "JGEN", 4) == 0 && chunk.size >= sizeof(uint64_t)) {
+            std::memcpy(&journalGeneration_, payload, sizeof(uint64_t));
+        } // Unknown chunks are skipped
+        offset += static_cast<size_t>(std::min<uint64_t>(chunk.size + paddingFor(chunk.size), size - offset));
+    }
+    if (!haveStrokes) {
+        error = path + " has no stroke table";
+        return false;
+    }
+
+    // Check every reference up front, so load() cannot fail halfway through. An encoded stroke
+    // is checked once the next one shows where its bytes end.
+    const SmkStrokeRecord* lastEncoded = nullptr;
+    for (uint64_t i = 0; i <= strokeCount_; ++i) {
+        const SmkStrokeRecord* encoded = nullptr;
+        if (i < strokeCount_ && isFreehandTool(static_cast<int>(strokes_[i].tool)) && (strokes_[i].flags & SMK_FLAG_ENCODED)) {
+            encoded = &strokes_[i];
+        }
+        if (lastEncoded && (encoded || i == strokeCount_)) {
+            uint64_t end = encoded ? encoded->range.first : encodedSize_;
+            if (end < lastEncoded->range.first || end > encodedSize_ ||
+                !validatePoints(encoded_ + lastEncoded->range.first, encoded_ + end, lastEncoded->range.count)) {
+                error = path + " has damaged point data";
+                return false;
+            }
+        }
+        if (encoded) lastEncoded = encoded;
+        if (i == strokeCount_) break;
+
+        const SmkStrokeRecord& record = strokes_[i];
+        bool valid = record.tool <= TOOL_MASK_FILL && hasFiniteBounds(record);
+        if (isFreehandTool(static_cast<int>(record.tool)) && (record.flags & SMK_FLAG_ENCODED)) {
+            valid = valid && record.range.first <= encodedSize_;
+        } else if (isFreehandTool(static_cast<int>(record.tool))) {
+            valid = valid && record.range.first <= pointCount_ && record.range.count <= pointCount_ - record.range.first;
+        } else if (record.tool == TOOL_MASK_FILL) {
+            valid = valid && record.range.first <= runCount_ && record.range.count <= runCount_ - record.range.first;
+        }
+        if (!valid) {
+            error = path + " has a damaged stroke (#" + std::to_string(i) + ")";
+            return false;
+        }
+    }
+    file_ = file;
+    return true;
+}
+
+void DocumentFile::load(Document& document) const {
+    if (!file_) return;
+    document.arena.keepAlive(file_);
+    document.strokes.reserve(document.strokes.size() + strokeCount_);
+    for (uint64_t i = 0; i < strokeCount_; ++i) {
+        const SmkStrokeRecord& record = strokes_[i];
+        Stroke stroke = unpackStroke(record);
+        if (stroke.tool == TOOL_MASK_FILL) {
+            stroke.mask.mask = document.masks.add(std::vector<MaskRun>(runs_ + record.range.first,
+                                                                       runs_ + record.range.first + record.range.count));
+        } else if (isFreehandTool(stroke.tool)) {
+            uint32_t bezier = stroke.freehand.bezier;
+            if (record.flags & SMK_FLAG_ENCODED) { // Validated by open(), so this cannot fail
+                const uint8_t* data = encoded_ + record.range.first;
+                decodePoints(data, encoded_ + encodedSize_, record.range.count, document.arena, stroke.freehand);
+            } else { // Chained in place, the points are not read here
+                stroke.freehand = document.arena.adopt(points_ + record.range.first, record.range.count);
+            }
+            stroke.freehand.bezier = bezier;
+            document.strokeBlocks += strokeBlockCount(stroke);
+        }
+        Bounds bounds = {record.bounds[0], record.bounds[1], record.bounds[2], record.bounds[3]};
+        document.index.insert(static_cast<uint32_t>(document.strokes.size()), bounds, stroke.size);
+        document.strokes.push_back(stroke);
+    }
+}
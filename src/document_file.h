@@ -0,0 +1,98 @@
+#pragma once
+#include "document.h"
+#include "mapped_file.h"
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+
+// --- Document Files (.smk) ---
+// Native binary format for saving and reopening drawings. Little-endian throughout.
+//
+//   Header  "SMK\x1A", u16 version, u16 header size (16), u32 chunk count, u32 reserved
+//   Chunks  char type[4], u32 reserved, u64 payload size, payload padded to 8 bytes
+//     STRK  u64 stroke count, then one 72-byte record per stroke: tool, size, color, flags,
+//           bounds, and the shape or a range in PNTS/RUNS
+//     PNTS  every freehand stroke's points (or Bezier control points), contiguous, as float x, y
+//     PNTZ  version 2, instead of PNTS: the same points delta/varint encoded (stroke_codec.h),
+//           each stroke's bytes running up to where the next encoded stroke's begin
+//     RUNS  every bucket fill's mask runs (MaskRun, 6 bytes)
+//     JGEN  optional u64: the autosave journal generation this snapshot starts (see journal.h)
+//
+// Readers skip chunks they do not know, so later versions can add chunks without breaking
+// older builds. Loading maps the file and chains freehand points in place (PointArena::adopt):
+// stroke records are read once, but point data is paged in only when a stroke is drawn, and
+// the spatial index is rebuilt from the stored bounds without touching any points.
+
+// --- Stroke records ---
+// One stroke's STRK entry. The autosave journal stores strokes in the same form.
+
+const uint32_t SMK_FLAG_BEZIER = 1; // PNTS range holds Bezier control points
+const uint32_t SMK_FLAG_ENCODED = 2; // range.first is a byte offset into PNTZ
+
+struct SmkRange {
+    uint64_t first; // Index of the first point/run
+    uint32_t count;
+    float origin[2]; // Masks only: MaskShape::origin...
+    float pixelSize[2]; // ...and pixel width/height
+};
+
+struct SmkStrokeRecord {
+    uint32_t tool;
+    float size;
+    float color[3];
+    uint32_t flags;
+    float bounds[4]; // minX, minY, maxX, maxY
+    union {
+        SmkRange range; // Freehand strokes (PNTS) and bucket fills (RUNS)
+        float shape[8]; // Rectangle/line: start, end. Circle: center, radius. Fill: min, max, center, radius
+    };
+};
+static_assert(sizeof(SmkStrokeRecord) == 72, "SmkStrokeRecord layout");
+
+// Fills a record from a stroke, with range.count set; range.first is left for the caller
+void packStroke(const Document& document, const Stroke& stroke, const Bounds& bounds, SmkStrokeRecord& record);
+// Rebuilds a stroke without its points or mask: the caller attaches freehand.* / mask.mask
+Stroke unpackStroke(const SmkStrokeRecord& record);
+// False if a record's bounds hold NaN or infinity (a damaged file: the spatial index needs numbers)
+bool hasFiniteBounds(const SmkStrokeRecord& record);
+
+// Flushes a stdio file and waits until the OS has written it to disk
+bool syncFile(FILE* file);
+
+struct SaveOptions {
+    // Store points encoded (2-2.7 bytes per point instead of 8, i.e. 3-4x smaller). Such
+    // files load by decoding every point into the arena, instead of mapping them in place.
+    bool compressPoints = false;
+    uint64_t journalGeneration = 0; // Stored in a JGEN chunk if non-zero
+};
+
+// Writes the committed strokes to `path`. The file is written next to it first, synced and renamed
+// over it, so a failed save leaves the previous file intact.
+bool saveDocument(const Document& document, const std::string& path, std::string& error,
+                  const SaveOptions& options = SaveOptions());
+
+class DocumentFile {
+public:
+    static const uint16_t VERSION = 2;
+
+    // Maps and validates a file; nothing is loaded yet
+    bool open(const std::string& path, std::string& error);
+    uint64_t strokeCount() const { return strokeCount_; }
+    uint64_t journalGeneration() const { return journalGeneration_; } // 0 without a JGEN chunk
+    // Appends the file's strokes to an empty document. Freehand points stay in the mapping,
+    // which the document's arena keeps alive (unless they were stored encoded).
+    void load(Document& document) const;
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    const SmkStrokeRecord* strokes_ = nullptr;
+    uint64_t strokeCount_ = 0;
+    const Point* points_ = nullptr;
+    uint64_t pointCount_ = 0;
+    const uint8_t* encoded_ = nullptr; // PNTZ
+    uint64_t encodedSize_ = 0;
+    const MaskRun* runs_ = nullptr;
+    uint64_t runCount_ = 0;
+    uint64_t journalGeneration_ = 0;
+};
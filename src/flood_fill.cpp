@@ -0,0 +1,105 @@
+#include "flood_fill.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Helper: Sets fillable[i] to 1 where pixel i's RGB is within `limit` of `seed` in every channel,
+// else 0. Sixteen pixels at a time with SSE2 (baseline on x86-64); the scalar loop does the rest.
+static void matchPixels(const uint8_t* pixels, size_t count, const uint8_t seed[3], uint8_t limit, uint8_t* fillable) {
+    size_t i = 0;
+#ifdef __SSE2__
+    uint32_t seedBits = seed[0] | (seed[1] << 8) | (seed[2] << 16);
+    const __m128i seedColor = _mm_set1_epi32(static_cast<int>(seedBits));
+    const __m128i limits = _mm_set1_epi32(limit | (limit << 8) | (limit << 16) | (255 << 24)); // Alpha always passes
+    const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+    for (; i + 16 <= count; i += 16) {
+        __m128i matched[4];
+        for (int q = 0; q < 4; ++q) {
+            __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + (i + q * 4) * 4));
+            __m128i difference = _mm_or_si128(_mm_subs_epu8(color, seedColor), _mm_subs_epu8(seedColor, color));
+            matched[q] = _mm_cmpeq_epi32(_mm_subs_epu8(difference, limits), zero); // All four bytes within limit
+        }
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(matched[0], matched[1]), _mm_packs_epi32(matched[2], matched[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(fillable + i), _mm_and_si128(packed, one));
+    }
+#endif
+    for (; i < count; ++i) {
+        const uint8_t* pixel = pixels + i * 4;
+        bool within = true;
+        for (int c = 0; c < 3; ++c) {
+            within &= (pixel[c] > seed[c] ? pixel[c] - seed[c] : seed[c] - pixel[c]) <= limit;
+        }
+        fillable[i] = within;
+    }
+}
+
+// Mask rows hold only 0s and 1s, so runs are scanned eight bytes at a time
+const uint64_t ALL_SET = 0x0101010101010101ull;
+
+// Helper: First x in [x, end) where the row is clear, or end
+static int findClear(const uint8_t* row, int x, int end) {
+    const void* found = std::memchr(row + x, 0, end - x);
+    return found ? static_cast<int>(static_cast<const uint8_t*>(found) - row) : end;
+}
+
+// Helper: First x in [x, end) where the row is set, or end
+static int findSet(const uint8_t* row, int x, int end) {
+    uint64_t word;
+    while (x + 8 <= end && (std::memcpy(&word, row + x, 8), word == 0)) x += 8;
+    while (x < end && !row[x]) ++x;
+    return x;
+}
+
+// Helper: Start of the set stretch that ends just before x
+static int findStretchStart(const uint8_t* row, int x) {
+    uint64_t word;
+    while (x >= 8 && (std::memcpy(&word, row + x - 8, 8), word == ALL_SET)) x -= 8;
+    while (x > 0 && row[x - 1]) --x;
+    return x;
+}
+
+const std::vector<MaskRun>& FloodFiller::fill(const uint8_t* pixels, int width, int height, int seedX, int seedY, int tolerance) {
+    runs_.clear();
+    if (seedX < 0 || seedY < 0 || seedX >= width || seedY >= height || width > 0xFFFF || height > 0xFFFF) return runs_;
+
+    // Every pixel is tested against the seed color up front, in one pass.
+    // The mask doubles as the visited set: filled pixels are cleared from it.
+    const size_t count = static_cast<size_t>(width) * height;
+    fillable_.resize(count);
+    uint8_t seedColor[3];
+    std::memcpy(seedColor, pixels + (static_cast<size_t>(seedY) * width + seedX) * 4, 3);
+    uint8_t* fillable = fillable_.data();
+    matchPixels(pixels, count, seedColor, static_cast<uint8_t>(std::max(0, std::min(255, tolerance))), fillable);
+
+    stack_.clear();
+    stack_.push_back({seedX, seedY});
+    while (!stack_.empty()) {
+        Seed seed = stack_.back();
+        stack_.pop_back();
+        uint8_t* row = fillable + static_cast<size_t>(seed.y) * width;
+        if (!row[seed.x]) continue; // Filled through another seed of the same run
+
+        // Widen the seed to its whole run
+        int x0 = findStretchStart(row, seed.x);
+        int x1 = findClear(row, seed.x, width); // Exclusive
+        std::memset(row + x0, 0, x1 - x0);
+        runs_.push_back({static_cast<uint16_t>(seed.y), static_cast<uint16_t>(x0), static_cast<uint16_t>(x1)});
+
+        // One seed per stretch of fillable pixels touching the run in the rows above and below
+        for (int y = seed.y - 1; y <= seed.y + 1; y += 2) {
+            if (y < 0 || y >= height) continue;
+            const uint8_t* neighbor = fillable + static_cast<size_t>(y) * width;
+            for (int x = findSet(neighbor, x0, x1); x < x1; x = findSet(neighbor, findClear(neighbor, x, x1), x1)) {
+                stack_.push_back({x, y});
+            }
+        }
+    }
+
+    std::sort(runs_.begin(), runs_.end(), [](const MaskRun& a, const MaskRun& b) {
+        return a.y != b.y ? a.y < b.y : a.x0 < b.x0;
+    });
+    return runs_;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "document.h"
+#include <vector>
+#include <cstdint>
+
+// --- Flood Fill ---
+// Bucket fill on the rasterized canvas. Starting from a seed pixel, every 4-connected pixel whose
+// color is within `tolerance` of the seed's (largest per-channel difference, 0..255) is collected
+// as runs along rows. Span-based scanline fill: each popped seed is widened to its whole run, and
+// the rows above and below are scanned once along that run for new seeds, so every pixel is
+// tested a small constant number of times and the seed stack stays proportional to the outline.
+
+class FloodFiller {
+public:
+    // `pixels` are RGBA rows of `width` pixels, row 0 first (alpha is ignored). Runs use the same
+    // row numbering and come out sorted by row, then column. Scratch buffers are reused between calls.
+    const std::vector<MaskRun>& fill(const uint8_t* pixels, int width, int height, int seedX, int seedY, int tolerance);
+
+private:
+    struct Seed { int x, y; };
+
+    std::vector<uint8_t> fillable_; // One byte per pixel: matches the seed color and is not filled yet
+    std::vector<Seed> stack_;
+    std::vector<MaskRun> runs_;
+};
@@ -0,0 +1,71 @@
+#include "frame_profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+void FrameProfiler::setEnabled(bool enabled) {
+    enabled_ = enabled;
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        cpu_[i] = Ring();
+        gpu_[i] = Ring();
+    }
+    frame_ = Ring();
+}
+
+void FrameProfiler::addCpuSample(FramePhase phase, double ms) {
+    cpu_[phase].add(ms);
+}
+
+void FrameProfiler::addGpuSample(FramePhase phase, double ms) {
+    gpu_[phase].add(ms);
+}
+
+void FrameProfiler::addFrame(double ms) {
+    frame_.add(ms);
+}
+
+const char* FrameProfiler::phaseName(FramePhase phase) {
+    static const char* names[PHASE_COUNT] = {"update", "chrome", "grid", "strokes", "current", "preview", "capture", "status", "swap"};
+    return names[phase];
+}
+
+std::string FrameProfiler::report() const {
+    std::string text;
+    char line[128];
+    Stats frame = frameStats();
+    std::snprintf(line, sizeof(line), "%-8s cpu %7.3f ms avg %7.3f ms p99 (%d frames)\n", "frame", frame.average, frame.p99, frame.count);
+    text += line;
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        Stats cpu = cpuStats(static_cast<FramePhase>(i)), gpu = gpuStats(static_cast<FramePhase>(i));
+        int n = std::snprintf(line, sizeof(line), "%-8s cpu %7.3f ms avg %7.3f ms p99", phaseName(static_cast<FramePhase>(i)), cpu.average, cpu.p99);
+        if (gpu.count > 0) std::snprintf(line + n, sizeof(line) - n, "   gpu %7.3f ms avg %7.3f ms p99", gpu.average, gpu.p99);
+        text += line;
+        text += '\n';
+    }
+    return text;
+}
+
+// --- Rolling window ---
+
+void FrameProfiler::Ring::add(double ms) {
+    values[next] = static_cast<float>(ms);
+    next = (next + 1) % WINDOW_FRAMES;
+    count = std::min(count + 1, WINDOW_FRAMES);
+}
+
+FrameProfiler::Stats FrameProfiler::Ring::stats() const {
+    Stats stats;
+    stats.count = count;
+    if (count == 0) return stats;
+    float sorted[WINDOW_FRAMES];
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sorted[i] = values[i];
+        sum += values[i];
+    }
+    // Nearest-rank percentile: with a full window, the second-largest sample
+    int rank = (99 * count + 99) / 100 - 1;
+    std::nth_element(sorted, sorted + rank, sorted + count);
+    stats.average = sum / count;
+    stats.p99 = sorted[rank];
+    return stats;
+}
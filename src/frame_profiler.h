@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+// --- Frame Profiler ---
+// Where frame time goes, for the profiler HUD. Each phase of a frame is wrapped in a
+// ProfileScope, which measures its CPU time (for GL work, the time to submit it); GPU time
+// comes from timer queries issued by the renderer and arrives a few frames late. The last
+// WINDOW_FRAMES samples of every phase are kept, from which the HUD shows a rolling average
+// and the 99th percentile. While disabled nothing is measured.
+
+enum FramePhase {
+    PHASE_CANVAS_UPDATE, // Newly committed strokes drawn into the cached canvas layer
+    PHASE_CHROME, // Panels, sidebar and top bar
+    PHASE_GRID,
+    PHASE_STROKES, // The cached layer, i.e. every committed stroke
+    PHASE_CURRENT_STROKE,
+    PHASE_PREVIEW, // Shape preview
+    PHASE_CAPTURE, // Screenshot readback
+    PHASE_STATUS_BAR, // Status bar and HUD
+    PHASE_SWAP, // Buffer swap, including any wait for vsync (CPU only)
+    PHASE_COUNT
+};
+
+class FrameProfiler {
+public:
+    static constexpr int WINDOW_FRAMES = 120;
+
+    struct Stats {
+        int count = 0;
+        double average = 0.0, p99 = 0.0; // Milliseconds
+    };
+
+    bool enabled() const { return enabled_; }
+    void setEnabled(bool enabled); // Starts over with no samples
+
+    void addCpuSample(FramePhase phase, double ms);
+    void addGpuSample(FramePhase phase, double ms);
+    void addFrame(double ms); // CPU time of the whole frame
+
+    Stats cpuStats(FramePhase phase) const { return cpu_[phase].stats(); }
+    Stats gpuStats(FramePhase phase) const { return gpu_[phase].stats(); }
+    Stats frameStats() const { return frame_.stats(); }
+    static const char* phaseName(FramePhase phase);
+
+    // One line per phase with CPU (and GPU, if measured) average and p99, for the console
+    std::string report() const;
+
+private:
+    struct Ring {
+        float values[WINDOW_FRAMES];
+        int next = 0, count = 0;
+
+        void add(double ms);
+        Stats stats() const;
+    };
+
+    bool enabled_ = false;
+    Ring cpu_[PHASE_COUNT];
+    Ring gpu_[PHASE_COUNT];
+    Ring frame_;
+};
+
+// Adds the CPU time between construction and destruction as a sample of `phase`
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, FramePhase phase) : profiler_(profiler), phase_(phase), active_(profiler.enabled()) {
+        if (active_) start_ = std::chrono::steady_clock::now();
+    }
+    ~ProfileScope() {
+        if (active_) profiler_.addCpuSample(phase_, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count());
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& profiler_;
+    FramePhase phase_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+};
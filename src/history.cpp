@@ -0,0 +1,204 @@
+#include "history.h"
+#include "stroke_codec.h"
+#include <utility>
+
+History::History(Document& document, size_t memoryLimit)
+    : document_(document), memoryLimit_(memoryLimit) {}
+
+// Helper: Memory an entry keeps alive (its own record plus any strokes and blocks it holds)
+size_t History::entryBytes(const Entry& entry) {
+    return sizeof(Entry) + entry.strokes.capacity() * sizeof(Stroke)
+         + entry.strokeBlocks * PointArena::BLOCK_POINTS * sizeof(Point) + entry.index.bytes()
+         + entry.packedPoints.capacity();
+}
+
+void History::pushUndo(Entry&& entry) {
+    entry.bytes = entryBytes(entry);
+    bytesHeld_ += entry.bytes;
+    undoStack_.push_back(std::move(entry));
+    enforceMemoryLimit();
+}
+
+void History::pushRedo(Entry&& entry) {
+    entry.bytes = entryBytes(entry);
+    bytesHeld_ += entry.bytes;
+    redoStack_.push_back(std::move(entry));
+}
+
+void History::commit(const Stroke& stroke) {
+    clearRedo(); // A new edit forks history; what was undone can no longer be redone
+    document_.index.insert(static_cast<uint32_t>(document_.strokes.size()), strokeBounds(document_, stroke), stroke.size);
+    document_.strokes.push_back(stroke);
+    document_.strokeBlocks += strokeBlockCount(stroke);
+
+    Entry entry;
+    entry.action = HistoryAction::Commit; // The stroke itself lives in the document
+    pushUndo(std::move(entry));
+}
+
+void History::reset() {
+    undoStack_.clear();
+    redoStack_.clear();
+    bytesHeld_ = 0;
+}
+
+bool History::clear() {
+    if (document_.strokes.empty()) return false;
+    clearRedo();
+
+    Entry entry;
+    entry.action = HistoryAction::Clear;
+    std::swap(entry.strokes, document_.strokes); // O(1): the vectors trade buffers
+    std::swap(entry.strokeBlocks, document_.strokeBlocks);
+    std::swap(entry.index, document_.index);
+    pushUndo(std::move(entry));
+    return true;
+}
+
+HistoryAction History::undo() {
+    if (undoStack_.empty()) return HistoryAction::None;
+    Entry entry = std::move(undoStack_.back());
+    undoStack_.pop_back();
+    bytesHeld_ -= entry.bytes;
+
+    if (entry.action == HistoryAction::Commit) {
+        entry.stroke = document_.strokes.back();
+        document_.strokes.pop_back();
+        entry.bounds = document_.index.bounds(static_cast<uint32_t>(document_.strokes.size()));
+        document_.index.removeLast();
+        entry.strokeBlocks = strokeBlockCount(entry.stroke);
+        document_.strokeBlocks -= entry.strokeBlocks;
+    } else {
+        // Everything committed after the clear has already been undone, so the live
+        // document is empty and swapping restores the pre-clear contents.
+        unpackPoints(entry);
+        std::swap(entry.strokes, document_.strokes);
+        std::swap(entry.strokeBlocks, document_.strokeBlocks);
+        std::swap(entry.index, document_.index);
+    }
+
+    HistoryAction action = entry.action;
+    pushRedo(std::move(entry));
+    return action;
+}
+
+HistoryAction History::redo() {
+    if (redoStack_.empty()) return HistoryAction::None;
+    Entry entry = std::move(redoStack_.back());
+    redoStack_.pop_back();
+    bytesHeld_ -= entry.bytes;
+
+    if (entry.action == HistoryAction::Commit) {
+        document_.index.insert(static_cast<uint32_t>(document_.strokes.size()), entry.bounds, entry.stroke.size);
+        document_.strokes.push_back(entry.stroke); // The chain was never released
+        document_.strokeBlocks += entry.strokeBlocks;
+        entry.strokeBlocks = 0;
+    } else {
+        std::swap(entry.strokes, document_.strokes);
+        std::swap(entry.strokeBlocks, document_.strokeBlocks);
+        std::swap(entry.index, document_.index);
+    }
+
+    HistoryAction action = entry.action;
+    pushUndo(std::move(entry));
+    return action;
+}
+
+void History::setMemoryLimit(size_t bytes) {
+    memoryLimit_ = bytes;
+    enforceMemoryLimit();
+}
+
+void History::releaseEntry(Entry& entry) {
+    if (entry.action == HistoryAction::Commit) {
+        releaseStroke(entry.stroke);
+    } else {
+        for (auto& stroke : entry.strokes) {
+            if (!entry.packedPoints.empty() && isFreehandTool(stroke.tool)) continue; // No chain
+            releaseStroke(stroke);
+        }
+    }
+    entry.strokeBlocks = 0;
+}
+
+bool History::compressIdle() {
+    // The newest entry stays as it is, so undoing a clear right away is still a swap
+    for (size_t i = 0; i + 1 < undoStack_.size(); ++i) {
+        Entry& entry = undoStack_[i];
+        bytesHeld_ -= entry.bytes;
+        bool packed = packPoints(entry);
+        entry.bytes = entryBytes(entry);
+        bytesHeld_ += entry.bytes;
+        if (packed) return true;
+    }
+    return false;
+}
+
+bool History::packPoints(Entry& entry) {
+    if (!compressCleared_ || entry.action != HistoryAction::Clear || entry.strokeBlocks == 0) return false;
+    for (auto& stroke : entry.strokes) {
+        if (!isFreehandTool(stroke.tool)) continue;
+        encodePoints(document_.arena, stroke.freehand, entry.packedPoints);
+        FreehandRef packed = stroke.freehand;
+        document_.arena.release(stroke.freehand);
+        stroke.freehand.count = packed.count; // Kept for decoding, with no blocks behind it
+        stroke.freehand.bezier = packed.bezier;
+    }
+    entry.packedPoints.shrink_to_fit();
+    entry.strokeBlocks = 0;
+    return true;
+}
+
+void History::unpackPoints(Entry& entry) {
+    if (entry.packedPoints.empty()) return;
+    const uint8_t* data = entry.packedPoints.data();
+    const uint8_t* end = data + entry.packedPoints.size();
+    for (auto& stroke : entry.strokes) {
+        if (!isFreehandTool(stroke.tool)) continue;
+        FreehandRef packed = stroke.freehand;
+        decodePoints(data, end, packed.count, document_.arena, stroke.freehand); // Our own encoding
+        stroke.freehand.bezier = packed.bezier;
+        entry.strokeBlocks += strokeBlockCount(stroke);
+    }
+    std::vector<uint8_t>().swap(entry.packedPoints);
+}
+
+// Helper: Returns a stroke's points or mask to the document's pools
+void History::releaseStroke(Stroke& stroke) {
+    if (isFreehandTool(stroke.tool)) {
+        document_.arena.release(stroke.freehand);
+    } else if (stroke.tool == TOOL_MASK_FILL) {
+        document_.masks.release(stroke.mask.mask);
+    }
+}
+
+void History::clearRedo() {
+    for (auto& entry : redoStack_) {
+        bytesHeld_ -= entry.bytes;
+        releaseEntry(entry);
+    }
+    redoStack_.clear();
+}
+
+// Evicts the oldest undo entries until history fits its memory limit. Evicted commits stay
+// in the document but can no longer be undone; an evicted clear frees the old strokes.
+// Clear entries still holding arena blocks are encoded first, oldest first, since that may
+// make room without losing anything. The redo stack is never evicted: the next commit
+// discards it as a whole anyway.
+void History::enforceMemoryLimit() {
+    for (size_t i = 0; i < undoStack_.size() && bytesHeld_ > memoryLimit_; ++i) {
+        Entry& entry = undoStack_[i];
+        bytesHeld_ -= entry.bytes;
+        packPoints(entry);
+        entry.bytes = entryBytes(entry);
+        bytesHeld_ += entry.bytes;
+    }
+    while (bytesHeld_ > memoryLimit_ && !undoStack_.empty()) {
+        Entry& oldest = undoStack_.front();
+        bytesHeld_ -= oldest.bytes;
+        if (oldest.action == HistoryAction::Clear) {
+            releaseEntry(oldest); // A commit entry's stroke is still in the document
+        }
+        undoStack_.pop_front();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "document.h"
+#include <deque>
+#include <vector>
+#include <cstddef>
+
+// --- Undo/Redo History ---
+// Every edit to a Document (stroke commit, fill, clear) is recorded as a reversible entry.
+// Clearing swaps the document's stroke table (and its spatial index) into the entry, so clear,
+// its undo and its redo are all O(1). Undone strokes move onto the redo stack with their
+// arena blocks; the blocks go back to the arena's free list once the stroke can no longer be
+// redone. Once the memory held by history exceeds the limit, the oldest entries are evicted.
+// A cleared stroke table that is no longer the latest entry is cold, so its freehand points
+// can be kept delta/varint encoded (stroke_codec.h) instead of in arena blocks, which lets far
+// more clears fit under the limit. Encoding is O(points), so it never happens inside clear:
+// the editor calls compressIdle() while waiting for input, and entries are encoded before
+// any is evicted once history is over its limit.
+
+enum class HistoryAction {
+    None,   // Nothing to undo/redo
+    Commit, // A stroke (or fill) was added/removed at the end of the document
+    Clear   // The whole document was swapped
+};
+
+class History {
+public:
+    explicit History(Document& document, size_t memoryLimit = 512u * 1024u * 1024u);
+
+    // Appends a stroke. A freehand stroke's chain must already live in the document's arena;
+    // the document takes ownership of it without copying any points.
+    void commit(const Stroke& stroke);
+    bool clear(); // False if the document was already empty
+    void reset(); // Forgets every entry without touching the document (it is about to be replaced)
+    HistoryAction undo();
+    HistoryAction redo();
+
+    void setMemoryLimit(size_t bytes);
+    void setCompressCleared(bool compress) { compressCleared_ = compress; } // On by default
+    // Encodes one cold clear entry (never the one undo would restore next); false if there was
+    // nothing to do. Meant for idle time: it takes about 30 ms per million points.
+    bool compressIdle();
+    size_t memoryUsage() const { return bytesHeld_; }
+    size_t undoDepth() const { return undoStack_.size(); }
+    size_t redoDepth() const { return redoStack_.size(); }
+
+private:
+    struct Entry {
+        HistoryAction action;
+        Stroke stroke;     // Commit on the redo stack: the undone stroke (owns its chain)...
+        Bounds bounds{};   // ...and its bounds, so redo does not recompute them
+        std::vector<Stroke> strokes; // Clear: the stroke table swapped out of the document...
+        SpatialIndex index; // ...and its bounds
+        std::vector<uint8_t> packedPoints; // Non-empty: the freehand points of `strokes`, encoded;
+                                           // their chains were released
+        size_t strokeBlocks = 0; // Arena blocks referenced by `stroke`/`strokes`
+        size_t bytes = 0;  // Memory this entry keeps alive, counted in memoryUsage()
+    };
+
+    static size_t entryBytes(const Entry& entry);
+    void pushUndo(Entry&& entry);
+    void pushRedo(Entry&& entry);
+    void releaseEntry(Entry& entry); // Frees the arena blocks and masks only this entry references
+    void releaseStroke(Stroke& stroke);
+    bool packPoints(Entry& entry); // Cold clear entries: chains -> packedPoints (false if it did nothing)
+    void unpackPoints(Entry& entry); // ...and back, before the strokes return to the document
+    void clearRedo();
+    void enforceMemoryLimit();
+
+    Document& document_;
+    std::deque<Entry> undoStack_; // Oldest first, evicted from the front
+    std::vector<Entry> redoStack_;
+    size_t memoryLimit_;
+    size_t bytesHeld_ = 0;
+    bool compressCleared_ = true;
+};
@@ -0,0 +1,116 @@
+#include "image_writer.h"
+#include "png_stream.h"
+#include "stb_image_write.h" // Implementation is compiled in main.cpp / batch_main.cpp
+#include <algorithm>
+#include <cctype>
+
+ImageWriter::ImageWriter() {
+    worker_ = std::thread(&ImageWriter::workerLoop, this); // Started once the members it uses exist
+}
+
+ImageWriter::~ImageWriter() {
+    finish();
+}
+
+void ImageWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void ImageWriter::submit(ImageJob&& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return; // Nobody would write it
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+bool ImageWriter::busy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writing_ || !jobs_.empty();
+}
+
+bool ImageWriter::pollResult(std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) return false;
+    message = std::move(results_.front());
+    results_.pop_front();
+    return true;
+}
+
+void ImageWriter::setOnFinished(std::function<void()> onFinished) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    onFinished_ = std::move(onFinished);
+}
+
+void ImageWriter::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) return; // Stopping, and every queued job is written
+
+        ImageJob job = std::move(jobs_.front());
+        jobs_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        std::string message;
+        write(job, message);
+        lock.lock();
+        writing_ = false;
+        results_.push_back(std::move(message));
+        if (onFinished_) onFinished_();
+    }
+}
+
+// Flips GL-ordered rows in place (no second buffer) and encodes by file extension (.png, .jpg
+// or .jpeg). PNGs are streamed; band-rendered PNGs never hold more than one band in memory.
+bool ImageWriter::write(ImageJob& job, std::string& message) {
+    std::string extension = job.path.substr(std::min(job.path.size(), job.path.rfind('.') + 1));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    const size_t rowBytes = static_cast<size_t>(job.width) * 4;
+    if (extension != "png" && extension != "jpg" && extension != "jpeg") {
+        message = "Cannot save " + job.path + ": unsupported format (use .png or .jpg)";
+        return false;
+    }
+
+    if (extension == "png" && job.renderRows) {
+        PngStreamWriter png;
+        bool ok = png.open(job.path, job.width, job.height);
+        std::vector<uint8_t> band;
+        for (int firstRow = 0; ok && firstRow < job.height; firstRow += job.bandRows) {
+            int rows = std::min(job.bandRows, job.height - firstRow);
+            ok = job.renderRows(firstRow, rows, band) && png.writeRows(band.data(), rows);
+        }
+        ok = png.close() && ok;
+        message = ok ? "Saved " + job.path : "Failed to save " + job.path;
+        return ok;
+    }
+
+    if (job.renderRows && !job.renderRows(0, job.height, job.pixels)) {
+        message = "Failed to render " + job.path;
+        return false;
+    }
+    if (job.bottomUp) {
+        for (int top = 0, bottom = job.height - 1; top < bottom; ++top, --bottom) {
+            std::swap_ranges(job.pixels.begin() + top * rowBytes, job.pixels.begin() + (top + 1) * rowBytes,
+                             job.pixels.begin() + bottom * rowBytes);
+        }
+    }
+
+    bool ok;
+    if (extension == "png") {
+        PngStreamWriter png;
+        ok = png.open(job.path, job.width, job.height);
+        ok = ok && png.writeRows(job.pixels.data(), job.height);
+        ok = png.close() && ok;
+    } else { // JPG drops the alpha channel
+        ok = stbi_write_jpg(job.path.c_str(), job.width, job.height, 4, job.pixels.data(), job.jpgQuality) != 0;
+    }
+    message = ok ? "Saved " + job.path : "Failed to save " + job.path;
+    return ok;
+}
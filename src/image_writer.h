@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// --- Image Writer ---
+// Encodes and saves images on a background thread, so exporting never stalls the render loop.
+// A job can also bring a render step that produces its pixels on that thread, band by band.
+// Jobs are written in submission order; each one leaves a status line ("Saved x.jpg") that the
+// UI thread collects with pollResult.
+
+struct ImageJob {
+    std::string path;
+    int width = 0, height = 0;
+    std::vector<uint8_t> pixels; // RGBA rows
+    bool bottomUp = false; // Rows are in GL order (first row is the bottom); flipped before encoding
+    int jpgQuality = 90;
+    // Optional: renders the image on the writer thread instead of taking `pixels`. Each call fills
+    // `rgba` with rows [firstRow, firstRow + rowCount), top to bottom; returning false fails the job.
+    // PNGs are rendered and streamed to disk `bandRows` rows at a time.
+    std::function<bool(int firstRow, int rowCount, std::vector<uint8_t>& rgba)> renderRows;
+    int bandRows = 256;
+};
+
+class ImageWriter {
+public:
+    ImageWriter();
+    ~ImageWriter(); // Finishes the queued jobs first (see finish)
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    void submit(ImageJob&& job);
+    bool busy(); // Jobs queued or being written
+    // Writes every queued job, then stops the writer thread; later submits are ignored. Call it
+    // before whatever the queued jobs use (e.g. a render thread pool) goes away.
+    void finish();
+
+    // Pops the status line of the oldest finished job
+    bool pollResult(std::string& message);
+
+    // Called on the writer thread after each job, e.g. to wake an event loop waiting for input
+    void setOnFinished(std::function<void()> onFinished);
+
+    // Renders (if the job says so) and encodes a job on the calling thread. `message` gets the
+    // status line either way.
+    static bool write(ImageJob& job, std::string& message);
+
+private:
+    void workerLoop();
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<ImageJob> jobs_;
+    std::deque<std::string> results_;
+    bool writing_ = false;
+    bool stopping_ = false;
+    std::function<void()> onFinished_;
+};
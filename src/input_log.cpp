@@ -0,0 +1,219 @@
+#include "input_log.h"
+#include "varint.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// --- On-disk layout ---
+
+static const char SMI_MAGIC[4] = {'S', 'M', 'I', '\x1A'};
+
+struct SmiHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint16_t windowWidth;
+    uint16_t windowHeight;
+    uint32_t strokes;
+};
+static_assert(sizeof(SmiHeader) == 16, "SmiHeader layout");
+
+const double SUBPIXELS = 256.0; // Fixed-point steps per window pixel (and per scroll step)
+
+// Helper: Window pixels -> fixed point, clamped to what a varint delta can hold
+static int32_t toFixed(double v) {
+    double scaled = std::round(v * SUBPIXELS);
+    if (!(scaled > -1e9)) return scaled < 0.0 ? -1000000000 : 0; // Also maps NaN to 0
+    return static_cast<int32_t>(std::min(scaled, 1e9));
+}
+
+// --- Recording ---
+
+InputRecorder::~InputRecorder() {
+    close();
+}
+
+bool InputRecorder::open(const std::string& path, int windowWidth, int windowHeight, uint32_t strokes, double now, std::string& error) {
+    close();
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        error = "cannot create " + path;
+        return false;
+    }
+    SmiHeader header;
+    std::memcpy(header.magic, SMI_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.headerSize = sizeof(SmiHeader);
+    header.windowWidth = static_cast<uint16_t>(std::max(0, std::min(65535, windowWidth)));
+    header.windowHeight = static_cast<uint16_t>(std::max(0, std::min(65535, windowHeight)));
+    header.strokes = strokes;
+    buffer_.assign(reinterpret_cast<const uint8_t*>(&header), reinterpret_cast<const uint8_t*>(&header) + sizeof(header));
+    lastTime_ = now;
+    lastX_ = lastY_ = 0;
+    if (!flush()) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool InputRecorder::record(const InputEvent& event) {
+    if (!file_) return false;
+    buffer_.push_back(event.type);
+    // Events are recorded as they arrive, so time only moves forward
+    double delay = std::max(0.0, event.time - lastTime_);
+    putUnsignedVarint(buffer_, static_cast<uint64_t>(std::llround(delay * 1e6)));
+    lastTime_ = std::max(lastTime_, event.time);
+
+    auto putCursor = [this, &event] {
+        int32_t x = toFixed(event.x), y = toFixed(event.y);
+        putVarint(buffer_, x - lastX_);
+        putVarint(buffer_, y - lastY_);
+        lastX_ = x;
+        lastY_ = y;
+    };
+    switch (event.type) {
+        case INPUT_MOUSE_BUTTON:
+            putVarint(buffer_, event.code);
+            putVarint(buffer_, event.action);
+            putVarint(buffer_, event.mods);
+            putCursor();
+            break;
+        case INPUT_KEY:
+            putVarint(buffer_, event.code);
+            putVarint(buffer_, event.scancode);
+            putVarint(buffer_, event.action);
+            putVarint(buffer_, event.mods);
+            break;
+        case INPUT_CURSOR_POS:
+            putCursor();
+            break;
+        case INPUT_SCROLL:
+            putCursor();
+            putVarint(buffer_, toFixed(event.scrollX));
+            putVarint(buffer_, toFixed(event.scrollY));
+            break;
+        case INPUT_WINDOW_SIZE:
+            putVarint(buffer_, event.width);
+            putVarint(buffer_, event.height);
+            break;
+        case INPUT_FRAME:
+            break;
+    }
+    return buffer_.size() < FLUSH_BYTES || flush();
+}
+
+bool InputRecorder::flush() {
+    bool ok = std::fwrite(buffer_.data(), 1, buffer_.size(), file_) == buffer_.size() && std::fflush(file_) == 0;
+    buffer_.clear();
+    if (!ok) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    return ok;
+}
+
+void InputRecorder::close() {
+    if (!file_) return;
+    if (!buffer_.empty() && !flush()) return;
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+// --- Replay ---
+
+bool InputReplay::open(const std::string& path, std::string& error) {
+    events_.clear();
+    next_ = 0;
+    truncated_ = false;
+
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[64 * 1024];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0) bytes.insert(bytes.end(), chunk, chunk + n);
+    std::fclose(file);
+
+    SmiHeader header;
+    if (bytes.size() < sizeof(header)) {
+        error = path + " is not an input log";
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, SMI_MAGIC, sizeof(header.magic)) != 0 || header.headerSize < sizeof(header) ||
+        header.headerSize > bytes.size()) {
+        error = path + " is not an input log";
+        return false;
+    }
+    if (header.version > InputRecorder::VERSION) {
+        error = path + " was recorded by a newer version";
+        return false;
+    }
+    windowWidth_ = header.windowWidth;
+    windowHeight_ = header.windowHeight;
+    initialStrokes_ = header.strokes;
+
+    const uint8_t* data = bytes.data() + header.headerSize;
+    const uint8_t* end = bytes.data() + bytes.size();
+    uint64_t micros = 0;
+    int32_t x = 0, y = 0;
+    while (data != end) {
+        InputEvent event;
+        uint8_t type = *data++;
+        uint64_t delay;
+        int32_t dx = 0, dy = 0;
+        bool ok = getUnsignedVarint(data, end, delay);
+        micros += delay;
+        event.type = static_cast<InputEventType>(type);
+        event.time = micros / 1e6;
+        switch (type) {
+            case INPUT_MOUSE_BUTTON:
+                ok = ok && getVarint(data, end, event.code) && getVarint(data, end, event.action) &&
+                     getVarint(data, end, event.mods) && getVarint(data, end, dx) && getVarint(data, end, dy);
+                break;
+            case INPUT_KEY:
+                ok = ok && getVarint(data, end, event.code) && getVarint(data, end, event.scancode) &&
+                     getVarint(data, end, event.action) && getVarint(data, end, event.mods);
+                break;
+            case INPUT_CURSOR_POS:
+                ok = ok && getVarint(data, end, dx) && getVarint(data, end, dy);
+                break;
+            case INPUT_SCROLL: {
+                int32_t scrollX = 0, scrollY = 0;
+                ok = ok && getVarint(data, end, dx) && getVarint(data, end, dy) &&
+                     getVarint(data, end, scrollX) && getVarint(data, end, scrollY);
+                event.scrollX = scrollX / SUBPIXELS;
+                event.scrollY = scrollY / SUBPIXELS;
+                break;
+            }
+            case INPUT_WINDOW_SIZE:
+                ok = ok && getVarint(data, end, event.width) && getVarint(data, end, event.height);
+                break;
+            case INPUT_FRAME:
+                break;
+            default:
+                ok = false; // Unknown type: the rest cannot be parsed
+        }
+        if (!ok) {
+            truncated_ = true;
+            break;
+        }
+        if (type == INPUT_MOUSE_BUTTON || type == INPUT_CURSOR_POS || type == INPUT_SCROLL) {
+            x += dx;
+            y += dy;
+        }
+        event.x = x / SUBPIXELS;
+        event.y = y / SUBPIXELS;
+        events_.push_back(event);
+    }
+    return true;
+}
+
+const InputEvent* InputReplay::poll(double elapsed, bool fast) {
+    if (!isActive() || (!fast && events_[next_].time > elapsed)) return nullptr;
+    return &events_[next_++];
+}
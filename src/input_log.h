@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+// --- Input Log ---
+// Records what the window system hands to the input callbacks, with timestamps, so a session
+// (and whatever performance problem it ran into) can be replayed exactly. Frames are logged
+// too, so a replay draws its frames between the same events as the recorded session, however
+// fast it runs.
+//
+//   "SMI\x1A", u16 version, u16 header size (16), u16 window width, u16 window height,
+//   u32 strokes in the document when recording started; then one record per event:
+//   u8 type, varint microseconds since the previous event, then the type's fields as varints
+//
+// Cursor positions are stored in 1/256 window pixel as the difference from the previous
+// position, scroll offsets in 1/256 step, so a cursor move usually takes 4-6 bytes. A replay
+// starts from the same window size and (normally empty) document; a torn tail, e.g. after a
+// crash, simply ends the replay early.
+
+enum InputEventType : uint8_t {
+    INPUT_MOUSE_BUTTON = 1, // code = button, action, mods, at (x, y)
+    INPUT_CURSOR_POS = 2, // (x, y)
+    INPUT_SCROLL = 3, // (scrollX, scrollY), at (x, y)
+    INPUT_KEY = 4, // code = key, scancode, action, mods
+    INPUT_WINDOW_SIZE = 5, // (width, height)
+    INPUT_FRAME = 6 // A frame was drawn
+};
+
+struct InputEvent {
+    InputEventType type = INPUT_FRAME;
+    double time = 0.0; // Seconds (recording: any clock; replay: since the log started)
+    int code = 0, scancode = 0, action = 0, mods = 0;
+    double x = 0.0, y = 0.0; // Cursor position in window pixels
+    double scrollX = 0.0, scrollY = 0.0;
+    int width = 0, height = 0;
+};
+
+class InputRecorder {
+public:
+    static constexpr uint16_t VERSION = 1;
+
+    InputRecorder() = default;
+    ~InputRecorder();
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    // Starts a new log; `now` is the time the first event's delay is measured from
+    bool open(const std::string& path, int windowWidth, int windowHeight, uint32_t strokes, double now, std::string& error);
+    bool isOpen() const { return file_ != nullptr; }
+    // Appends an event; false (and the log is closed) if writing failed
+    bool record(const InputEvent& event);
+    void close(); // Writes what is buffered
+
+private:
+    static constexpr size_t FLUSH_BYTES = 64 * 1024;
+
+    bool flush();
+
+    FILE* file_ = nullptr;
+    std::vector<uint8_t> buffer_;
+    double lastTime_ = 0.0;
+    int32_t lastX_ = 0, lastY_ = 0; // Previous cursor position, 1/256 pixel
+};
+
+class InputReplay {
+public:
+    // Reads and decodes a whole log
+    bool open(const std::string& path, std::string& error);
+    bool isActive() const { return next_ < events_.size(); }
+    int windowWidth() const { return windowWidth_; }
+    int windowHeight() const { return windowHeight_; }
+    uint32_t initialStrokes() const { return initialStrokes_; }
+    size_t eventCount() const { return events_.size(); }
+    bool truncated() const { return truncated_; } // The log ended in the middle of a record
+
+    // The next event, if it is due `elapsed` seconds into the replay (always in `fast` mode);
+    // nullptr otherwise or at the end of the log
+    const InputEvent* poll(double elapsed, bool fast);
+    double nextEventTime() const { return isActive() ? events_[next_].time : 0.0; }
+
+private:
+    std::vector<InputEvent> events_;
+    size_t next_ = 0;
+    int windowWidth_ = 0, windowHeight_ = 0;
+    uint32_t initialStrokes_ = 0;
+    bool truncated_ = false;
+};
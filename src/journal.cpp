@@ -0,0 +1,352 @@
+#include "journal.h"
+#include "document_file.h"
+#include "stroke_codec.h"
+#include "crc32.h"
+#include <chrono>
+#include <cstring>
+
+// --- On-disk records ---
+
+static const char SMJ_MAGIC[4] = {'S', 'M', 'J', '\x1A'};
+
+struct SmjHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint64_t generation;
+};
+static_assert(sizeof(SmjHeader) == 16, "SmjHeader layout");
+
+struct SmjRecordHeader {
+    uint32_t type;
+    uint32_t size; // Payload bytes
+    uint32_t crc; // CRC-32 of the payload
+    uint32_t reserved;
+};
+static_assert(sizeof(SmjRecordHeader) == 16, "SmjRecordHeader layout");
+
+// Helper: Appends raw bytes to a byte buffer
+static void putBytes(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// Helper: Returns a removed stroke's points or mask to the document's pools
+static void releaseStroke(Document& document, Stroke& stroke) {
+    if (isFreehandTool(stroke.tool)) {
+        document.arena.release(stroke.freehand);
+    } else if (stroke.tool == TOOL_MASK_FILL) {
+        document.masks.release(stroke.mask.mask);
+    }
+}
+
+// --- Recording (drawing thread) ---
+
+Journal::~Journal() {
+    close();
+}
+
+void Journal::appendRecord(RecordType type, const std::vector<uint8_t>& payload) {
+    SmjRecordHeader header;
+    header.type = type;
+    header.size = static_cast<uint32_t>(payload.size());
+    header.crc = crc32(0, payload.data(), payload.size());
+    header.reserved = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty() || tasks_.back().snapshot) tasks_.emplace_back();
+        std::vector<uint8_t>& records = tasks_.back().records;
+        putBytes(records, &header, sizeof(header));
+        putBytes(records, payload.data(), payload.size());
+    }
+    wake_.notify_one();
+    journalBytes_ += sizeof(header) + payload.size();
+}
+
+void Journal::recordCommit(const Document& document) {
+    if (!isOpen() || document.strokes.empty()) return;
+    const Stroke& stroke = document.strokes.back();
+    SmkStrokeRecord record;
+    packStroke(document, stroke, document.index.bounds(static_cast<uint32_t>(document.strokes.size() - 1)), record);
+
+    if (isFreehandTool(stroke.tool)) record.flags |= SMK_FLAG_ENCODED;
+
+    payload_.clear();
+    putBytes(payload_, &record, sizeof(record));
+    if (isFreehandTool(stroke.tool)) {
+        encodePoints(document.arena, stroke.freehand, payload_);
+    } else if (stroke.tool == TOOL_MASK_FILL) {
+        const std::vector<MaskRun>& runs = document.masks.runs(stroke.mask.mask);
+        putBytes(payload_, runs.data(), runs.size() * sizeof(MaskRun));
+    }
+    appendRecord(RECORD_COMMIT, payload_);
+    if (journalBytes_ >= COMPACT_BYTES) compact(document);
+}
+
+void Journal::recordPop() {
+    if (!isOpen()) return;
+    payload_.clear();
+    appendRecord(RECORD_POP, payload_);
+}
+
+void Journal::recordClear() {
+    if (!isOpen()) return;
+    payload_.clear();
+    appendRecord(RECORD_CLEAR, payload_);
+}
+
+void Journal::compact(const Document& document) {
+    if (!isOpen()) return;
+    // The copy is taken now; writing it out happens on the writer thread
+    std::shared_ptr<Document> snapshot = std::make_shared<Document>();
+    copyDocument(document, *snapshot);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Task task;
+        task.snapshot = std::move(snapshot);
+        tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+    journalBytes_ = 0;
+}
+
+bool Journal::pollError(std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (errors_.empty()) return false;
+    message = std::move(errors_.front());
+    errors_.pop_front();
+    return true;
+}
+
+// --- Recovery ---
+
+size_t Journal::open(const std::string& basePath, Document& document) {
+    close();
+    snapshotPath_ = basePath + ".smk";
+    journalPath_ = basePath + ".journal";
+
+    uint64_t generation = 0;
+    if (FILE* probe = std::fopen(snapshotPath_.c_str(), "rb")) {
+        std::fclose(probe);
+        DocumentFile snapshot;
+        std::string error;
+        if (snapshot.open(snapshotPath_, error)) {
+            snapshot.load(document);
+            generation = snapshot.journalGeneration();
+#ifdef _WIN32
+            document.arena.internalize(); // The next compaction has to replace the mapped file
+#endif
+        } else {
+            reportError(error);
+        }
+    }
+    bool damaged = false;
+    size_t replayed = replay(journalPath_, generation, document, damaged);
+
+    generation_ = generation;
+    stopping_ = false;
+    journalBytes_ = 0;
+    worker_ = std::thread(&Journal::workerLoop, this);
+    // Fold what was replayed (or cut off a damaged tail) into a fresh snapshot. Otherwise the
+    // journal is started lazily, so it is never truncated before its records are safe.
+    if (replayed > 0 || damaged) compact(document);
+    return document.strokes.size();
+}
+
+// Applies the journal's records to `document`. Returns how many were applied.
+size_t Journal::replay(const std::string& path, uint64_t generation, Document& document, bool& damaged) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return 0;
+    std::vector<uint8_t> data;
+    if (std::fseek(file, 0, SEEK_END) == 0) {
+        long size = std::ftell(file);
+        if (size > 0 && std::fseek(file, 0, SEEK_SET) == 0) {
+            data.resize(static_cast<size_t>(size));
+            data.resize(std::fread(data.data(), 1, data.size(), file));
+        }
+    }
+    std::fclose(file);
+
+    SmjHeader header;
+    if (data.size() < sizeof(header)) {
+        damaged = !data.empty();
+        return 0;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, SMJ_MAGIC, 4) != 0 || header.version > VERSION ||
+        header.headerSize < sizeof(header) || header.headerSize > data.size()) {
+        damaged = true;
+        return 0;
+    }
+    if (header.generation != generation) return 0; // Already part of the snapshot
+
+    size_t applied = 0;
+    size_t offset = header.headerSize;
+    while (offset < data.size()) {
+        SmjRecordHeader record;
+        if (data.size() - offset < sizeof(record)) {
+            damaged = true;
+            break;
+        }
+        std::memcpy(&record, data.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        const uint8_t* payload = data.data() + offset;
+        if (record.size > data.size() - offset || crc32(0, payload, record.size) != record.crc) {
+            damaged = true; // Torn write at the tail
+            break;
+        }
+        offset += record.size;
+
+        if (record.type == RECORD_COMMIT) {
+            SmkStrokeRecord stored;
+            if (record.size < sizeof(stored)) {
+                damaged = true;
+                break;
+            }
+            std::memcpy(&stored, payload, sizeof(stored));
+            const uint8_t* extra = payload + sizeof(stored);
+            size_t extraSize = record.size - sizeof(stored);
+            bool freehand = isFreehandTool(static_cast<int>(stored.tool));
+            bool mask = stored.tool == TOOL_MASK_FILL;
+            bool encoded = (stored.flags & SMK_FLAG_ENCODED) != 0;
+            bool valid = stored.tool <= TOOL_MASK_FILL && hasFiniteBounds(stored);
+            if (freehand && encoded) {
+                valid = valid && validatePoints(extra, extra + extraSize, stored.range.count);
+            } else if (freehand) { // Raw points, as written before records were encoded
+                valid = valid && extraSize == stored.range.count * sizeof(Point);
+            } else {
+                valid = valid && extraSize == (mask ? stored.range.count * sizeof(MaskRun) : 0);
+            }
+            if (!valid) {
+                damaged = true;
+                break;
+            }
+            Stroke stroke = unpackStroke(stored);
+            if (freehand) {
+                uint32_t bezier = stroke.freehand.bezier;
+                if (encoded) {
+                    decodePoints(extra, extra + extraSize, stored.range.count, document.arena, stroke.freehand);
+                } else {
+                    for (uint32_t i = 0; i < stored.range.count; ++i) {
+                        Point point;
+                        std::memcpy(&point, extra + i * sizeof(Point), sizeof(Point));
+                        document.arena.append(stroke.freehand, point);
+                    }
+                }
+                stroke.freehand.bezier = bezier;
+                document.strokeBlocks += strokeBlockCount(stroke);
+            } else if (mask) {
+                std::vector<MaskRun> runs(stored.range.count);
+                if (!runs.empty()) std::memcpy(runs.data(), extra, extraSize);
+                stroke.mask.mask = document.masks.add(std::move(runs));
+            }
+            Bounds bounds = {stored.bounds[0], stored.bounds[1], stored.bounds[2], stored.bounds[3]};
+            document.index.insert(static_cast<uint32_t>(document.strokes.size()), bounds, stroke.size);
+            document.strokes.push_back(stroke);
+        } else if (record.type == RECORD_POP) {
+            if (!document.strokes.empty()) {
+                Stroke stroke = document.strokes.back();
+                document.strokes.pop_back();
+                document.index.removeLast();
+                document.strokeBlocks -= strokeBlockCount(stroke);
+                releaseStroke(document, stroke);
+            }
+        } else if (record.type == RECORD_CLEAR) {
+            for (auto& stroke : document.strokes) {
+                releaseStroke(document, stroke);
+            }
+            document.strokes.clear();
+            document.index.clear();
+            document.strokeBlocks = 0;
+        } // Unknown record types are skipped
+        ++applied;
+    }
+    return applied;
+}
+
+// --- Writer thread ---
+
+void Journal::close() {
+    if (!worker_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void Journal::reportError(const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    errors_.push_back(message);
+}
+
+bool Journal::startJournal(uint64_t generation) {
+    if (file_) std::fclose(file_);
+    file_ = std::fopen(journalPath_.c_str(), "wb");
+    if (!file_) {
+        reportError("cannot create " + journalPath_);
+        return false;
+    }
+    SmjHeader header;
+    std::memcpy(header.magic, SMJ_MAGIC, 4);
+    header.version = VERSION;
+    header.headerSize = sizeof(SmjHeader);
+    header.generation = generation;
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1 || !syncFile(file_)) {
+        reportError("cannot write " + journalPath_);
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool Journal::writeSnapshot(const Document& snapshot, uint64_t generation) {
+    std::string error;
+    SaveOptions options;
+    options.journalGeneration = generation; // Left uncompressed so recovery can map it
+    if (!saveDocument(snapshot, snapshotPath_, error, options)) {
+        reportError(error);
+        return false;
+    }
+    return true;
+}
+
+void Journal::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) break; // Stopping with nothing left to write
+        // Let records pile up for a moment so each fsync covers a batch (skipped when closing)
+        wake_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] { return stopping_; });
+        std::deque<Task> tasks;
+        tasks.swap(tasks_);
+        lock.unlock();
+
+        bool unsynced = false;
+        for (Task& task : tasks) {
+            if (!task.records.empty() && (file_ || startJournal(generation_))) {
+                if (std::fwrite(task.records.data(), 1, task.records.size(), file_) != task.records.size()) {
+                    reportError("cannot write " + journalPath_);
+                }
+                unsynced = true;
+            }
+            // Snapshot first, then the new journal: until both exist, recovery still uses the old pair
+            if (task.snapshot && writeSnapshot(*task.snapshot, generation_ + 1)) {
+                ++generation_;
+                startJournal(generation_);
+                unsynced = false;
+            }
+            task.snapshot.reset(); // Frees the copy on this thread
+        }
+        if (unsynced && file_ && !syncFile(file_)) {
+            reportError("cannot sync " + journalPath_);
+        }
+        lock.lock();
+    }
+}
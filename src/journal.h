@@ -0,0 +1,92 @@
+#pragma once
+#include "document.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+
+// --- Autosave Journal ---
+// Every edit to the document is appended to an on-disk journal, so a crash or an accidental
+// close loses at most the last fraction of a second of work. Autosave uses two files next
+// to each other:
+//
+//   <base>.smk      snapshot: a regular document file (document_file.h) with a JGEN chunk
+//   <base>.journal  "SMJ\x1A", u16 version, u16 header size (16), u64 generation, then records:
+//                   u32 type, u32 payload size, u32 CRC-32 of the payload, u32 reserved, payload
+//
+// Records describe effects on the stroke list, not user actions: COMMIT appends a stroke
+// (SmkStrokeRecord followed by its encoded points, see stroke_codec.h, or mask runs), POP removes the last stroke, CLEAR
+// empties the document. Undo of a commit is a POP, redo of a commit is a COMMIT again, and
+// undo of a clear (which brings back a whole stroke table) is written as a compaction.
+//
+// The drawing thread only serializes records into memory. A writer thread batches them,
+// appends them and fsyncs the journal at most every FLUSH_INTERVAL_MS. Compaction writes a
+// copy of the document as a new snapshot with the next generation and then starts an empty
+// journal of that generation; on startup the journal is only replayed on top of a snapshot
+// of the same generation, so a crash at any point of a compaction loses nothing and never
+// replays a record twice. Replay stops at the first torn or corrupt record.
+
+class Journal {
+public:
+    static constexpr uint16_t VERSION = 1;
+    static constexpr int FLUSH_INTERVAL_MS = 250; // Longest a record waits in memory
+    static constexpr size_t COMPACT_BYTES = 8u * 1024u * 1024u; // Journal size that triggers compaction
+
+    Journal() = default;
+    ~Journal(); // Writes what is still queued
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Restores the last session from `<basePath>.smk` and `<basePath>.journal` into an empty
+    // document, then starts journaling. Returns the number of strokes recovered.
+    size_t open(const std::string& basePath, Document& document);
+    bool isOpen() const { return worker_.joinable(); }
+    void close(); // Flushes, syncs and stops the writer thread
+
+    // Record edits right after they were applied to `document`
+    void recordCommit(const Document& document); // The last stroke was added
+    void recordPop(); // The last stroke was removed
+    void recordClear();
+    // Snapshots the whole document (e.g. after undoing a clear or opening a file) and starts
+    // a fresh journal. Also called automatically once the journal reaches COMPACT_BYTES.
+    void compact(const Document& document);
+
+    // Pops the oldest error the writer thread ran into
+    bool pollError(std::string& message);
+
+private:
+    enum RecordType : uint32_t { RECORD_COMMIT = 1, RECORD_POP = 2, RECORD_CLEAR = 3 };
+
+    // Records to append, or a snapshot that ends the current journal generation
+    struct Task {
+        std::vector<uint8_t> records;
+        std::shared_ptr<Document> snapshot;
+    };
+
+    void appendRecord(RecordType type, const std::vector<uint8_t>& payload);
+    size_t replay(const std::string& path, uint64_t generation, Document& document, bool& damaged);
+    void workerLoop();
+    bool startJournal(uint64_t generation); // Writer thread: replaces the journal with an empty one
+    bool writeSnapshot(const Document& snapshot, uint64_t generation);
+    void reportError(const std::string& message);
+
+    std::string snapshotPath_, journalPath_;
+    size_t journalBytes_ = 0; // Appended since the last compaction (drawing thread)
+    std::vector<uint8_t> payload_; // Scratch for the record being built (drawing thread)
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task> tasks_;
+    std::deque<std::string> errors_;
+    bool stopping_ = false;
+
+    // Writer thread only
+    FILE* file_ = nullptr;
+    uint64_t generation_ = 0;
+};
@@ -8,14 +8,29 @@
 #include <algorithm> // For std::min, std::max, std::abs
 #include <string>
 #include <sstream> // For std::stringstream
+#include <cstdlib> // For std::atoi, std::atof
+
+#include "document.h"
+#include "history.h"
+#include "simplify.h"
+#include "curves.h"
+#include "stroke_geometry.h"
+#include "flood_fill.h"
+#include "image_writer.h"
+#include "raster.h"
+#include "canvas_layout.h"
+#include "document_file.h"
+#include "journal.h"
+#include "input_log.h"
+#include "frame_profiler.h"
+#include <memory>
 
 // For image saving functionality
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h" // Make sure this header file is in your include path
 
 // --- Theme Colors ---
-// Main Background: Light blue-grey
-const float BG_R = 0.91f, BG_G = 0.95f, BG_B = 0.96f; // E8F3F7
+// Main Background: BG_R/G/B in canvas_layout.h
 
 // Panel Background: Cream white
 const float PANEL_R = 1.0f, PANEL_G = 1.0f, PANEL_B = 1.0f; // FFFFFF
@@ -48,27 +63,11 @@ const float SHADOW_ALPHA = 0.2f; // Semi-transparent
 // Grid Color
 const float GRID_R = 0.85f, GRID_G = 0.85f, GRID_B = 0.85f; // Faint grey
 
-// --- Structures ---
-struct Point {
-    float x, y;
-    float r, g, b;
-    Point(float x_coord = 0, float y_coord = 0, float red = 0, float green = 0, float blue = 0)
-        : x(x_coord), y(y_coord), r(red), g(green), b(blue) {}
-};
-
-struct Stroke {
-    std::vector<Point> points; // Points for brush/eraser/line/outline
-    int tool; // 0=brush, 1=eraser, 2=rectangle, 3=circle, 4=line, 5=fill
-    float size; // Size for brush/eraser/outline thickness
-    float fillColor[3] = {0, 0, 0}; // Color for fill tool
-    Point rectStart, rectEnd; // For filled rectangle bounds
-    Point circleCenter; // For filled circle center
-    float circleRadius; // For filled circle radius
-};
-
 // --- Global Variables ---
-std::vector<Stroke> strokes;
-Stroke currentStroke;
+Document document; // Committed strokes
+History history(document); // Undo/redo for every edit to `document`
+Journal journal; // Autosave: every edit to `document` is also appended to an on-disk journal
+Stroke currentStroke; // Freehand stroke being drawn; its samples are appended to `document.arena`
 float currentColor[3] = {0.0f, 0.0f, 0.0f}; // Active drawing color
 float customColor[3] = {0.0f, 0.0f, 0.0f}; // RGB slider state
 float brushSize = 3.0f;
@@ -85,26 +84,45 @@ bool isHoveringEraserSlider = false;
 
 Point shapeStart, shapeEnd; // For shape previews
 
-int windowWidth = 1000, windowHeight = 700;
-float uiWidth = 0.20f; // Wider sidebar for better spacing
+int windowWidth = DEFAULT_WINDOW_WIDTH, windowHeight = DEFAULT_WINDOW_HEIGHT;
+float uiWidth = SIDEBAR_WIDTH_GL;
 
 bool showGrid = false; // Grid toggle
 
+// Freehand strokes are reduced on commit: fitted to cubic curves, or (if that does not pay off)
+// simplified by dropping samples that do not change what is drawn
+bool fitCurves = true; // --no-curves disables it
+float curveTolerancePx = 0.5f; // Max distance of the fitted curve from the samples (--curve-tolerance PX)
+bool simplifyStrokes = true; // --no-simplify disables it
+float simplifyTolerancePx = 0.5f; // --simplify-tolerance PX
+CurveFitter curveFitter;
+StrokeSimplifier strokeSimplifier;
+size_t freehandSamplesIn = 0; // Raw samples committed this session...
+size_t freehandPointsStored = 0; // ...and the points kept for them after fitting/simplification
+
+// The fill tool floods the area of similar color around the click, as the canvas is drawn
+int fillTolerance = 32; // Largest per-channel difference from the clicked color, 0..255 (--fill-tolerance N)
+FloodFiller floodFiller;
+std::vector<uint8_t> fillReadback; // Reused copy of the canvas layer, composited over white
+
+// Frame pacing: by default the main loop sleeps on input and only redraws when something changed
+bool eventDrivenLoop = true; // False = redraw continuously (--continuous)
+int swapInterval = 1; // Passed to glfwSwapInterval, 0 disables vsync (--swap-interval N)
+double maxFrameRate = 120.0; // Frame cap in frames per second, 0 = uncapped (--fps-cap N)
+const double IDLE_WAIT_TIMEOUT_SEC = 0.5; // Longest the loop blocks before re-checking for work
+bool redrawRequested = true; // Set by input/resize, cleared once a frame is presented
+
 // Array defining the order of tools in the UI
 int tools_order[] = {0, 1, 2, 3, 4, 5};
 std::string toolNames[] = {"Brush", "Eraser", "Rectangle", "Circle", "Line", "Fill"};
 
-// UI Layout Constants (in OpenGL coordinates, from -1.0 to 1.0)
-const float SIDEBAR_LEFT_GL = -1.0f;
-const float SIDEBAR_RIGHT_GL = -1.0f + uiWidth;
+// UI Layout Constants (in OpenGL coordinates, from -1.0 to 1.0); the canvas area's are in canvas_layout.h
 const float PADDING_X_GL = 0.025f; // Horizontal padding
-const float PADDING_Y_GL = 0.035f; // Vertical padding
 
 const float SLIDER_VERTICAL_SPACING_GL = 0.015f;
 const float SECTION_PADDING_Y_GL = 0.05f;
 
 const float BUTTON_HEIGHT_GL = 0.08f;
-const float COLOR_SWATCH_SIZE_GL = 0.07f; // Slightly smaller color swatches
 const float SLIDER_HEIGHT_GL = 0.03f;
 const float SLIDER_THUMB_WIDTH_GL = 0.012f; // Slightly wider thumb
 const float CORNER_RADIUS_GL = 0.01f; // Global corner radius for UI elements
@@ -112,15 +130,6 @@ const float CORNER_RADIUS_GL = 0.01f; // Global corner radius for UI elements
 // Adjusted vertical height for major UI labels to fix alignment
 const float UI_LABEL_BLOCK_HEIGHT = 0.05f; // Adjusted for better vertical alignment and spacing
 
-// Top Bar Constants
-const float TOP_BAR_HEIGHT_GL = COLOR_SWATCH_SIZE_GL + 2 * PADDING_Y_GL;
-const float CANVAS_TOP_GL = 1.0f - TOP_BAR_HEIGHT_GL;
-
-// Status Bar Constants for defining the drawing area
-const float STATUS_BAR_TEXT_SCALE = 0.003f;
-const float CALCULATED_STATUS_BAR_HEIGHT_GL = (STATUS_BAR_TEXT_SCALE * 1.0f) + PADDING_Y_GL; // Text height + vertical padding for status bar
-const float DRAWING_AREA_BOTTOM_GL = -1.0f + CALCULATED_STATUS_BAR_HEIGHT_GL; // The effective bottom limit for drawing
-
 const float ICON_DRAW_SIZE_GL = 0.05f; // Standard size for tool icons
 
 // --- Helper Functions (Coordinates & Hit Testing) ---
@@ -149,6 +158,24 @@ bool isInCanvas(float glX, float glY) {
 }
 
 
+// Marks the scene dirty so the main loop presents a new frame
+void requestRedraw() {
+    redrawRequested = true;
+}
+
+// Transient status bar message (e.g. "Saved drawing.jpg"), also echoed to the console
+std::string statusMessage; // Shown in the status bar until statusMessageUntil
+double statusMessageUntil = 0.0;
+const double STATUS_MESSAGE_SEC = 4.0;
+
+void showStatusMessage(const std::string& message) {
+    statusMessage = message;
+    statusMessageUntil = glfwGetTime() + STATUS_MESSAGE_SEC;
+    std::cout << message << std::endl;
+    requestRedraw();
+}
+
+
 // --- Drawing Primitives ---
 
 void drawRect(float x, float y, float w, float h, float r, float g, float b, float alpha = 1.0f) {
@@ -391,6 +418,22 @@ void drawText(float x, float y, const char* text, float r, float g, float b, flo
             case ' ': glTranslatef(0.8f, 0, 0); break;
             case '.': glVertex2f(0.5,0); glVertex2f(0.5,0.1); break;
             case '!': glVertex2f(0.5,0); glVertex2f(0.5,0.75); glVertex2f(0.5,1); glVertex2f(0.5,1); break;
+            // Digits and punctuation for numbers (segment style)
+            case '0': glVertex2f(0,0); glVertex2f(0,1); glVertex2f(0,1); glVertex2f(1,1); glVertex2f(1,1); glVertex2f(1,0); glVertex2f(1,0); glVertex2f(0,0); glVertex2f(0,0); glVertex2f(1,1); break;
+            case '1': glVertex2f(0.5,0); glVertex2f(0.5,1); glVertex2f(0.5,1); glVertex2f(0.2,0.75); break;
+            case '2': glVertex2f(0,1); glVertex2f(1,1); glVertex2f(1,1); glVertex2f(1,0.5); glVertex2f(1,0.5); glVertex2f(0,0.5); glVertex2f(0,0.5); glVertex2f(0,0); glVertex2f(0,0); glVertex2f(1,0); break;
+            case '3': glVertex2f(0,1); glVertex2f(1,1); glVertex2f(1,1); glVertex2f(1,0); glVertex2f(1,0); glVertex2f(0,0); glVertex2f(0.2,0.5); glVertex2f(1,0.5); break;
+            case '4': glVertex2f(0,1); glVertex2f(0,0.5); glVertex2f(0,0.5); glVertex2f(1,0.5); glVertex2f(1,1); glVertex2f(1,0); break;
+            case '5': glVertex2f(1,1); glVertex2f(0,1); glVertex2f(0,1); glVertex2f(0,0.5); glVertex2f(0,0.5); glVertex2f(1,0.5); glVertex2f(1,0.5); glVertex2f(1,0); glVertex2f(1,0); glVertex2f(0,0); break;
+            case '6': glVertex2f(1,1); glVertex2f(0,1); glVertex2f(0,1); glVertex2f(0,0); glVertex2f(0,0); glVertex2f(1,0); glVertex2f(1,0); glVertex2f(1,0.5); glVertex2f(1,0.5); glVertex2f(0,0.5); break;
+            case '7': glVertex2f(0,1); glVertex2f(1,1); glVertex2f(1,1); glVertex2f(0.4,0); break;
+            case '8': glVertex2f(0,0); glVertex2f(0,1); glVertex2f(0,1); glVertex2f(1,1); glVertex2f(1,1); glVertex2f(1,0); glVertex2f(1,0); glVertex2f(0,0); glVertex2f(0,0.5); glVertex2f(1,0.5); break;
+            case '9': glVertex2f(1,0.5); glVertex2f(0,0.5); glVertex2f(0,0.5); glVertex2f(0,1); glVertex2f(0,1); glVertex2f(1,1); glVertex2f(1,1); glVertex2f(1,0); glVertex2f(1,0); glVertex2f(0,0); break;
+            case '/': glVertex2f(0,0); glVertex2f(1,1); break;
+            case ':': glVertex2f(0.5,0.2); glVertex2f(0.5,0.3); glVertex2f(0.5,0.7); glVertex2f(0.5,0.8); break;
+            case ',': glVertex2f(0.5,0.1); glVertex2f(0.3,-0.2); break;
+            case '-': glVertex2f(0.2,0.5); glVertex2f(0.8,0.5); break;
+            case '|': glVertex2f(0.5,-0.2); glVertex2f(0.5,1.1); break;
         }
         glEnd();
         glTranslatef(1.2f, 0, 0);
@@ -789,6 +832,9 @@ void drawStatusBar() {
         ss << ", Size: " << eraserSize;
     }
     status_text += ss.str();
+    if (!statusMessage.empty()) {
+        status_text += "  |  " + statusMessage;
+    }
 
     float text_scale = STATUS_BAR_TEXT_SCALE; // Use the dedicated constant
     float text_width = std::strlen(status_text.c_str()) * text_scale * 0.8f; // Rough estimate
@@ -807,60 +853,641 @@ void drawStatusBar() {
     drawText(x + PADDING_X_GL, y + (bar_height - text_height)/2.0f, status_text.c_str(), TEXT_R, TEXT_G, TEXT_B, text_scale);
 }
 
-// Drawing logic: Renders all previously completed strokes/shapes
-void drawStrokes() {
-    for (const auto& stroke : strokes) {
-        if (stroke.tool == 5) { // If it's a fill stroke
-            glColor3f(stroke.fillColor[0], stroke.fillColor[1], stroke.fillColor[2]);
-            if (stroke.circleRadius > 0) {
-                drawCircle(stroke.circleCenter.x, stroke.circleCenter.y, stroke.circleRadius,
-                           stroke.fillColor[0], stroke.fillColor[1], stroke.fillColor[2], true);
-            } else {
-                float minX = std::min(stroke.rectStart.x, stroke.rectEnd.x);
-                float maxX = std::max(stroke.rectStart.x, stroke.rectEnd.x);
-                float minY = std::min(stroke.rectStart.y, stroke.rectEnd.y);
-                float maxY = std::max(stroke.rectStart.y, stroke.rectEnd.y);
-                drawRect(minX, minY, maxX - minX, maxY - minY,
-                         stroke.fillColor[0], stroke.fillColor[1], stroke.fillColor[2]);
-            }
-            continue;
+// --- Frame Profiler HUD ---
+// F3 (or --profile) shows how long each phase of render() took over the last frames, in a panel
+// at the top right of the canvas: CPU average and p99 and, with GL 3.3 timer queries, the GPU
+// time of the same phases. A GL timestamp is taken at the start of every phase; each frame's
+// timestamps are read back GPU_QUERY_FRAMES frames later, so the HUD never stalls the GPU.
+
+FrameProfiler frameProfiler;
+bool gpuTimers = false; // GL_TIMESTAMP queries are available
+const int GPU_QUERY_FRAMES = 4; // Query sets in flight
+GLuint gpuQueries[GPU_QUERY_FRAMES][PHASE_COUNT];
+bool gpuQueriesIssued[GPU_QUERY_FRAMES] = {}; // The set holds a whole frame's timestamps
+int gpuQuerySet = 0; // Set used by the current frame
+const float HUD_TEXT_SCALE = 0.012f;
+
+// Helper: Timer queries (GL 3.3 / ARB_timer_query) can be used; otherwise their functions are null
+bool timerQueriesSupported() {
+    return GLAD_GL_VERSION_3_3 && glQueryCounter && glGetQueryObjectui64v;
+}
+
+void initGpuTimers() {
+    gpuTimers = timerQueriesSupported();
+    if (gpuTimers) glGenQueries(GPU_QUERY_FRAMES * PHASE_COUNT, &gpuQueries[0][0]);
+}
+
+void deleteGpuTimers() {
+    if (gpuTimers) glDeleteQueries(GPU_QUERY_FRAMES * PHASE_COUNT, &gpuQueries[0][0]);
+}
+
+void toggleProfilerHud() {
+    frameProfiler.setEnabled(!frameProfiler.enabled());
+    std::fill(gpuQueriesIssued, gpuQueriesIssued + GPU_QUERY_FRAMES, false);
+}
+
+// Moves on to the next query set, first collecting the GPU times it holds from an earlier
+// frame (skipped if the GPU has not finished that frame yet)
+void beginProfiledFrame() {
+    if (!gpuTimers || !frameProfiler.enabled()) return;
+    gpuQuerySet = (gpuQuerySet + 1) % GPU_QUERY_FRAMES;
+    if (!gpuQueriesIssued[gpuQuerySet]) return;
+    gpuQueriesIssued[gpuQuerySet] = false;
+    const GLuint* queries = gpuQueries[gpuQuerySet];
+    GLint available = 0;
+    glGetQueryObjectiv(queries[PHASE_SWAP], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+    GLuint64 stamps[PHASE_COUNT];
+    for (int i = 0; i < PHASE_COUNT; ++i) glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &stamps[i]);
+    // A phase's GPU time runs up to the next phase's timestamp; the swap has no end stamp
+    for (int i = 0; i < PHASE_SWAP; ++i) frameProfiler.addGpuSample(static_cast<FramePhase>(i), (stamps[i + 1] - stamps[i]) / 1e6);
+}
+
+// Times one phase of a frame: CPU time while in scope, GPU time from a timestamp at its start
+struct FramePhaseScope {
+    explicit FramePhaseScope(FramePhase phase) : cpu(frameProfiler, phase) {
+        if (!gpuTimers || !frameProfiler.enabled()) return;
+        glQueryCounter(gpuQueries[gpuQuerySet][phase], GL_TIMESTAMP);
+        if (phase == PHASE_SWAP) gpuQueriesIssued[gpuQuerySet] = true; // Last phase of the frame
+    }
+    ProfileScope cpu;
+};
+
+// Helper: Milliseconds with two decimals
+std::string formatMs(double ms) {
+    std::stringstream ss;
+    ss.precision(2);
+    ss << std::fixed << ms;
+    return ss.str();
+}
+
+// UI element: Draws the profiler panel (phase, CPU avg/p99, GPU avg/p99 in milliseconds)
+void drawProfilerHud() {
+    if (!frameProfiler.enabled()) return;
+    const int rows = PHASE_COUNT + 2; // Header and the whole frame first
+    float lineHeight = HUD_TEXT_SCALE * 2.2f;
+    float nameWidth = HUD_TEXT_SCALE * 9.0f, columnWidth = HUD_TEXT_SCALE * 10.0f;
+    int columns = gpuTimers ? 4 : 2;
+    float width = nameWidth + columns * columnWidth + 2 * PADDING_X_GL;
+    float height = rows * lineHeight + PADDING_Y_GL;
+    float x = 1.0f - PADDING_X_GL - width;
+    float y = CANVAS_TOP_GL - PADDING_Y_GL / 2.0f - height;
+
+    drawRoundedRect(x, y, width, height, PANEL_R, PANEL_G, PANEL_B, CORNER_RADIUS_GL);
+    drawRoundedRectOutline(x, y, width, height, BORDER_R, BORDER_G, BORDER_B, CORNER_RADIUS_GL);
+
+    auto drawRow = [&](int row, const char* name, const std::string* cells) {
+        float textY = y + height - PADDING_Y_GL / 2.0f - (row + 1) * lineHeight + (lineHeight - HUD_TEXT_SCALE) / 2.0f;
+        drawText(x + PADDING_X_GL, textY, name, TEXT_R, TEXT_G, TEXT_B, HUD_TEXT_SCALE, 1.0f);
+        for (int c = 0; c < columns; ++c) {
+            drawText(x + PADDING_X_GL + nameWidth + c * columnWidth, textY, cells[c].c_str(), TEXT_R, TEXT_G, TEXT_B, HUD_TEXT_SCALE, 1.0f);
         }
+    };
+    std::string header[4] = {"cpu avg", "p99", "gpu avg", "p99"};
+    drawRow(0, "ms", header);
+    FrameProfiler::Stats frame = frameProfiler.frameStats();
+    std::string frameCells[4] = {formatMs(frame.average), formatMs(frame.p99), "", ""};
+    drawRow(1, "frame", frameCells);
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        FramePhase phase = static_cast<FramePhase>(i);
+        FrameProfiler::Stats cpu = frameProfiler.cpuStats(phase), gpu = frameProfiler.gpuStats(phase);
+        std::string cells[4] = {formatMs(cpu.average), formatMs(cpu.p99),
+                                gpu.count > 0 ? formatMs(gpu.average) : "-", gpu.count > 0 ? formatMs(gpu.p99) : "-"};
+        drawRow(i + 2, FrameProfiler::phaseName(phase), cells);
+    }
+}
 
-        if (stroke.tool == 1) { // Eraser
-            // Eraser now draws with the canvas background color for seamless erasing
-            glColor3f(BG_R, BG_G, BG_B); 
-        } else { // Brush or Shapes
-            if (!stroke.points.empty()) {
-                glColor3f(stroke.points[0].r, stroke.points[0].g, stroke.points[0].b);
-            } else {
-                glColor3f(0.0f, 0.0f, 0.0f);
+// --- Retained Stroke Geometry ---
+// Committed strokes are uploaded once into a single growable VBO when they are pushed.
+// Consecutive strokes sharing the same color and size are grouped into a batch so a frame
+// only issues a few multi-draw calls instead of re-submitting every point with glVertex2f.
+
+// Vertex format of the stroke VBO. Positions are quantized to 16 bits by default, halving the
+// buffer (4 bytes per vertex) at well under 0.1 px of error; define SKETCHMATE_FLOAT_VERTICES
+// to upload full-precision floats instead.
+#ifdef SKETCHMATE_FLOAT_VERTICES
+typedef Point StrokeVertex;
+const GLenum STROKE_VERTEX_GL_TYPE = GL_FLOAT;
+const float STROKE_VERTEX_SCALE = 1.0f;
+inline StrokeVertex makeStrokeVertex(float x, float y) { return Point(x, y); }
+#else
+typedef PackedPoint StrokeVertex;
+const GLenum STROKE_VERTEX_GL_TYPE = GL_SHORT;
+const float STROKE_VERTEX_SCALE = 1.0f / PACKED_POINT_SCALE;
+inline StrokeVertex makeStrokeVertex(float x, float y) { return packPoint(Point(x, y)); }
+#endif
+
+// A run of consecutive committed strokes that can be drawn with the same GL state
+struct StrokeBatch {
+    bool isFill; // Fill batches are triangle lists, others are dabs + line strips
+    float r, g, b;
+    float size;
+    size_t firstStroke; // Index of the batch's first stroke in `document.strokes`
+    GLint firstVertex; // First vertex of the batch in the VBO (outline batches are contiguous)
+    GLsizei vertexCount;
+    int strokeCount;
+    std::vector<GLint> firsts; // Per-primitive starts for glMultiDrawArrays
+    std::vector<GLsizei> counts;
+};
+
+// Where each committed stroke lives in the VBO, so undo can release it
+struct UploadedStroke {
+    GLint first;
+    GLsizei count;
+    bool hasPrimitive; // False for single-point strokes, which only contribute a dab
+    size_t batchIndex; // Batch the stroke belongs to
+    int primitiveIndex; // Index of its entry in the batch's firsts/counts (or where it would be)
+};
+
+GLuint strokeVbo = 0;
+GLsizei strokeVboCapacity = 0; // In vertices
+GLsizei strokeVboCount = 0; // In vertices
+std::vector<StrokeBatch> strokeBatches;
+std::vector<UploadedStroke> uploadedStrokes;
+std::vector<StrokeVertex> strokeUploadScratch; // Reused staging buffer for one stroke's vertices
+StrokeTessellator strokeTessellator;
+std::vector<uint32_t> strokeQueryScratch; // Reused result buffer for spatial index queries
+int strokeGeometryWidth = 0, strokeGeometryHeight = 0; // Window size the uploaded curve strokes were flattened for
+
+const GLsizei STROKE_VBO_INITIAL_CAPACITY = 64 * 1024;
+
+void initStrokeGeometry() {
+    glGenBuffers(1, &strokeVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, strokeVbo);
+    glBufferData(GL_ARRAY_BUFFER, STROKE_VBO_INITIAL_CAPACITY * sizeof(StrokeVertex), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    strokeVboCapacity = STROKE_VBO_INITIAL_CAPACITY;
+    strokeVboCount = 0;
+}
+
+// Helper: Grows the VBO on the GPU side (copying existing vertices) so it can hold `required` vertices
+void reserveStrokeGeometry(GLsizei required) {
+    if (required <= strokeVboCapacity) return;
+    GLsizei newCapacity = std::max(required, strokeVboCapacity * 2);
+
+    GLuint newVbo;
+    glGenBuffers(1, &newVbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * sizeof(StrokeVertex), nullptr, GL_DYNAMIC_DRAW);
+    if (strokeVboCount > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, strokeVbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, strokeVboCount * sizeof(StrokeVertex));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &strokeVbo);
+
+    strokeVbo = newVbo;
+    strokeVboCapacity = newCapacity;
+}
+
+// Helper: Fills strokeUploadScratch with the vertices a stroke is drawn with (see StrokeTessellator).
+// Closed loops and 2-point lines can all be drawn as GL_LINE_STRIP with the same pixels as
+// GL_LINE_LOOP/GL_LINES; curve strokes are flattened for the current window size.
+void buildStrokeVertices(const Stroke& stroke) {
+    CurveScale scale;
+    scale.pixelsPerUnitX = windowWidth / 2.0f;
+    scale.pixelsPerUnitY = windowHeight / 2.0f;
+    strokeUploadScratch.clear();
+    for (const auto& point : strokeTessellator.tessellate(document, stroke, scale)) {
+        strokeUploadScratch.push_back(makeStrokeVertex(point.x, point.y));
+    }
+}
+
+// Helper: The flat color a committed stroke is drawn with
+void getStrokeDrawColor(const Stroke& stroke, float& r, float& g, float& b) {
+    if (stroke.tool == TOOL_ERASER) { // Eraser draws with the canvas background color
+        r = BG_R; g = BG_G; b = BG_B;
+    } else {
+        r = stroke.color[0]; g = stroke.color[1]; b = stroke.color[2];
+    }
+}
+
+// Uploads a newly committed stroke and appends it to the current batch (or starts a new one)
+void uploadStrokeGeometry(const Stroke& stroke) {
+    buildStrokeVertices(stroke);
+    GLsizei count = static_cast<GLsizei>(strokeUploadScratch.size());
+    GLint first = strokeVboCount;
+
+    reserveStrokeGeometry(strokeVboCount + count);
+    if (count > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, strokeVbo);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(StrokeVertex), count * sizeof(StrokeVertex), strokeUploadScratch.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    strokeVboCount += count;
+
+    bool isFill = isFillTool(stroke.tool);
+    float r, g, b;
+    getStrokeDrawColor(stroke, r, g, b);
+    float size = isFill ? 0.0f : stroke.size;
+
+    // Strokes only merge when their GL state is identical. With equal colors the blended
+    // result is order-independent, so drawing all dabs before all strips gives the same pixels.
+    bool startBatch = strokeBatches.empty();
+    if (!startBatch) {
+        const StrokeBatch& last = strokeBatches.back();
+        startBatch = last.isFill != isFill || last.r != r || last.g != g || last.b != b || last.size != size;
+    }
+    if (startBatch) {
+        StrokeBatch batch;
+        batch.isFill = isFill;
+        batch.r = r; batch.g = g; batch.b = b;
+        batch.size = size;
+        batch.firstStroke = uploadedStrokes.size();
+        batch.firstVertex = first;
+        batch.vertexCount = 0;
+        batch.strokeCount = 0;
+        strokeBatches.push_back(batch);
+    }
+
+    StrokeBatch& batch = strokeBatches.back();
+    bool hasPrimitive = !isFill && count > 1; // Fills need no per-stroke draw ranges
+    int primitiveIndex = static_cast<int>(batch.firsts.size());
+    if (hasPrimitive) {
+        batch.firsts.push_back(first);
+        batch.counts.push_back(count);
+    }
+    batch.vertexCount += count;
+    batch.strokeCount++;
+    uploadedStrokes.push_back({first, count, hasPrimitive, strokeBatches.size() - 1, primitiveIndex});
+}
+
+// Releases the most recently uploaded stroke (used by undo). No GPU work is needed:
+// the vertices are simply overwritten by the next upload.
+void removeLastStrokeGeometry() {
+    if (uploadedStrokes.empty()) return;
+    UploadedStroke last = uploadedStrokes.back();
+    uploadedStrokes.pop_back();
+
+    StrokeBatch& batch = strokeBatches.back();
+    if (last.hasPrimitive) {
+        batch.firsts.pop_back();
+        batch.counts.pop_back();
+    }
+    batch.vertexCount -= last.count;
+    batch.strokeCount--;
+    if (batch.strokeCount == 0) {
+        strokeBatches.pop_back();
+    }
+    strokeVboCount = last.first;
+}
+
+void resetStrokeGeometry() {
+    strokeBatches.clear();
+    uploadedStrokes.clear();
+    strokeVboCount = 0;
+}
+
+// Drawing logic: Renders committed strokes [first, last) from the retained VBO.
+// Each batch overlapping the range costs one dab draw and one multi-draw of line strips,
+// so replaying a slice of history is as cheap per stroke as a full redraw.
+void drawStrokeRange(size_t first, size_t last) {
+    last = std::min(last, uploadedStrokes.size());
+    if (first >= last) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, strokeVbo);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, STROKE_VERTEX_GL_TYPE, 0, nullptr);
+    glPushMatrix();
+    glScalef(STROKE_VERTEX_SCALE, STROKE_VERTEX_SCALE, 1.0f); // Packed vertices back to NDC
+
+    size_t i = first;
+    while (i < last) {
+        const UploadedStroke& startStroke = uploadedStrokes[i];
+        const StrokeBatch& batch = strokeBatches[startStroke.batchIndex];
+        size_t batchEnd = std::min(last, batch.firstStroke + batch.strokeCount);
+        const UploadedStroke& endStroke = uploadedStrokes[batchEnd - 1];
+
+        GLint vertexFirst = startStroke.first;
+        GLsizei vertexCount = endStroke.first + endStroke.count - vertexFirst;
+        int primitiveFirst = startStroke.primitiveIndex;
+        GLsizei primitiveCount = endStroke.primitiveIndex + (endStroke.hasPrimitive ? 1 : 0) - primitiveFirst;
+
+        glColor3f(batch.r, batch.g, batch.b);
+        if (batch.isFill) {
+            glDrawArrays(GL_TRIANGLES, vertexFirst, vertexCount);
+        } else {
+            glPointSize(batch.size);
+            glDrawArrays(GL_POINTS, vertexFirst, vertexCount);
+            if (primitiveCount > 0) {
+                glLineWidth(batch.size / 2.0f);
+                glMultiDrawArrays(GL_LINE_STRIP, batch.firsts.data() + primitiveFirst, batch.counts.data() + primitiveFirst, primitiveCount);
             }
         }
+        i = batchEnd;
+    }
 
-        glPointSize(stroke.size);
-        glBegin(GL_POINTS);
-        for (const auto& point : stroke.points) {
-            glVertex2f(point.x, point.y);
+    glPopMatrix();
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Drawing logic: Renders all previously completed strokes/shapes from the retained VBO
+void drawStrokes() {
+    drawStrokeRange(0, uploadedStrokes.size());
+}
+
+// --- Cached Canvas Layer ---
+// Committed strokes are rasterized into a persistent texture covering the canvas area.
+// New strokes are drawn into it incrementally; undo, clear and resizes rebuild it.
+// The layer is stored premultiplied (transparent where nothing is drawn) so the
+// white canvas and grid underneath still show through when it is composited.
+
+GLuint canvasFbo = 0;
+GLuint canvasTexture = 0;
+int canvasCacheX = 0, canvasCacheY = 0; // Lower-left corner of the canvas in window pixels
+int canvasCacheWidth = 0, canvasCacheHeight = 0;
+bool canvasCacheValid = false;
+size_t canvasCachedStrokes = 0; // Number of committed strokes already in the texture
+
+// Helper: The canvas drawing area in window pixel coordinates (origin bottom-left)
+void getCanvasPixelRect(int& x, int& y, int& width, int& height) {
+    x = static_cast<int>((SIDEBAR_RIGHT_GL + 1.0f) / 2.0f * windowWidth);
+    y = static_cast<int>((DRAWING_AREA_BOTTOM_GL + 1.0f) / 2.0f * windowHeight); // Bottom of drawing area in pixels
+    canvasPixelSize(windowWidth, windowHeight, width, height);
+}
+
+void initCanvasCache() {
+    glGenFramebuffers(1, &canvasFbo);
+    glGenTextures(1, &canvasTexture);
+    glBindTexture(GL_TEXTURE_2D, canvasTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void invalidateCanvasCache() {
+    canvasCacheValid = false;
+}
+
+// Helper: Binds the canvas FBO with a viewport that maps window NDC onto the canvas texture,
+// so strokes land on exactly the same pixels as when drawn to the window.
+void beginCanvasCacheDraw() {
+    glBindFramebuffer(GL_FRAMEBUFFER, canvasFbo);
+    glViewport(-canvasCacheX, -canvasCacheY, windowWidth, windowHeight);
+    // Premultiplied output: color uses the normal blend, alpha accumulates coverage
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void endCanvasCacheDraw() {
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+// --- Undo Checkpoints ---
+// Snapshots of the canvas layer taken every few strokes (or every few ms of GPU rasterization).
+// When undo invalidates the layer, the newest snapshot at or below the new stroke count is
+// blitted back and only the strokes after it are replayed, so undo cost does not grow with
+// the length of the history. Snapshots are kept under a memory budget by thinning old ones.
+
+struct CanvasCheckpoint {
+    size_t strokeCount; // Number of committed strokes rasterized into the snapshot
+    GLuint texture;
+};
+
+std::vector<CanvasCheckpoint> canvasCheckpoints; // Ordered by strokeCount
+std::vector<GLuint> spareCheckpointTextures; // Released snapshots, reused at the current canvas size
+GLuint checkpointFbo = 0; // Scratch FBO used to blit to/from snapshot textures
+
+size_t checkpointStrokeInterval = 64; // Take a snapshot at least every N strokes...
+double checkpointWorkIntervalMs = 8.0; // ...or after this much GPU rasterization time
+size_t checkpointMemoryBudget = 256u * 1024u * 1024u; // Bytes of snapshot textures kept alive
+
+size_t strokesSinceCheckpoint = 0;
+double rasterWorkSinceCheckpointMs = 0.0;
+
+// GPU timer queries measuring canvas rasterization work (read back without stalling). Without
+// timer queries, snapshots are only taken every checkpointStrokeInterval strokes.
+bool rasterTimers = false;
+std::vector<GLuint> pendingRasterQueries;
+std::vector<GLuint> freeRasterQueries;
+
+void initCanvasCheckpoints() {
+    glGenFramebuffers(1, &checkpointFbo);
+    rasterTimers = timerQueriesSupported();
+}
+
+size_t maxCanvasCheckpoints() {
+    size_t bytesPerCheckpoint = static_cast<size_t>(canvasCacheWidth) * canvasCacheHeight * 4;
+    if (bytesPerCheckpoint == 0) return 0;
+    return checkpointMemoryBudget / bytesPerCheckpoint;
+}
+
+void releaseCheckpoint(const CanvasCheckpoint& checkpoint) {
+    spareCheckpointTextures.push_back(checkpoint.texture);
+}
+
+// Drops snapshots that contain strokes beyond `strokeCount` (they no longer match history)
+void discardCheckpointsAfter(size_t strokeCount) {
+    while (!canvasCheckpoints.empty() && canvasCheckpoints.back().strokeCount > strokeCount) {
+        releaseCheckpoint(canvasCheckpoints.back());
+        canvasCheckpoints.pop_back();
+    }
+}
+
+// Deletes every snapshot texture (used when the canvas size changes)
+void deleteAllCheckpoints() {
+    for (const auto& checkpoint : canvasCheckpoints) {
+        glDeleteTextures(1, &checkpoint.texture);
+    }
+    canvasCheckpoints.clear();
+    if (!spareCheckpointTextures.empty()) {
+        glDeleteTextures(static_cast<GLsizei>(spareCheckpointTextures.size()), spareCheckpointTextures.data());
+        spareCheckpointTextures.clear();
+    }
+    strokesSinceCheckpoint = 0;
+    rasterWorkSinceCheckpointMs = 0.0;
+}
+
+// Helper: Removes every other snapshot from the older half, keeping recent history dense.
+// With fewer than four snapshots that removes nothing, so the oldest one goes instead.
+void thinCheckpoints() {
+    if (canvasCheckpoints.empty()) return;
+    size_t half = canvasCheckpoints.size() / 2;
+    if (half < 2) {
+        releaseCheckpoint(canvasCheckpoints.front());
+        canvasCheckpoints.erase(canvasCheckpoints.begin());
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < canvasCheckpoints.size(); ++i) {
+        if (i < half && i % 2 == 1) {
+            releaseCheckpoint(canvasCheckpoints[i]);
+        } else {
+            canvasCheckpoints[kept++] = canvasCheckpoints[i];
         }
-        glEnd();
+    }
+    canvasCheckpoints.resize(kept);
+}
 
-        if (stroke.points.size() > 1) {
-            glLineWidth(stroke.size / 2.0f);
-            if (stroke.tool == 2) { // Rectangle outline
-                glBegin(GL_LINE_LOOP);
-            } else if (stroke.tool == 3) { // Circle outline
-                glBegin(GL_LINE_LOOP); 
-            } else if (stroke.tool == 4) { // Line tool
-                glBegin(GL_LINES);
-            } else { // Brush/Eraser
-                glBegin(GL_LINE_STRIP);
-            }
-            for (const auto& point : stroke.points) {
-                glVertex2f(point.x, point.y);
-            }
-            glEnd();
+void beginRasterTiming() {
+    if (!rasterTimers) return;
+    GLuint query;
+    if (!freeRasterQueries.empty()) {
+        query = freeRasterQueries.back();
+        freeRasterQueries.pop_back();
+    } else {
+        glGenQueries(1, &query);
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    pendingRasterQueries.push_back(query);
+}
+
+void endRasterTiming() {
+    if (rasterTimers) glEndQuery(GL_TIME_ELAPSED);
+}
+
+// Adds finished timer query results to the work counter; unfinished queries are left for later
+void collectRasterTimings() {
+    size_t done = 0;
+    while (done < pendingRasterQueries.size()) {
+        GLuint query = pendingRasterQueries[done];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+        rasterWorkSinceCheckpointMs += elapsedNs / 1.0e6;
+        freeRasterQueries.push_back(query);
+        ++done;
+    }
+    pendingRasterQueries.erase(pendingRasterQueries.begin(), pendingRasterQueries.begin() + done);
+}
+
+// Copies the current canvas layer into a new snapshot. Expects the canvas FBO to be bound.
+void takeCanvasCheckpoint() {
+    strokesSinceCheckpoint = 0;
+    rasterWorkSinceCheckpointMs = 0.0;
+
+    size_t maxCheckpoints = maxCanvasCheckpoints();
+    if (maxCheckpoints == 0) return;
+    if (!canvasCheckpoints.empty() && canvasCheckpoints.back().strokeCount == canvasCachedStrokes) return;
+
+    GLuint texture;
+    if (!spareCheckpointTextures.empty()) {
+        texture = spareCheckpointTextures.back();
+        spareCheckpointTextures.pop_back();
+    } else {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, canvasCacheWidth, canvasCacheHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, checkpointFbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, canvasFbo);
+    glBlitFramebuffer(0, 0, canvasCacheWidth, canvasCacheHeight, 0, 0, canvasCacheWidth, canvasCacheHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, canvasFbo);
+
+    canvasCheckpoints.push_back({canvasCachedStrokes, texture});
+    while (canvasCheckpoints.size() > maxCheckpoints) {
+        thinCheckpoints(); // Removes at least one snapshot per pass
+    }
+}
+
+// Blits a snapshot back into the canvas layer. Expects the canvas FBO to be bound.
+void restoreCanvasCheckpoint(const CanvasCheckpoint& checkpoint) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, checkpointFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, checkpoint.texture, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, canvasFbo);
+    glBlitFramebuffer(0, 0, canvasCacheWidth, canvasCacheHeight, 0, 0, canvasCacheWidth, canvasCacheHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, canvasFbo);
+}
+
+// Brings the canvas texture up to date with the committed strokes before it is composited.
+// An invalid layer restarts from the newest usable checkpoint (or from empty); the remaining
+// strokes are then replayed in checkpoint-sized chunks, taking new snapshots along the way.
+void updateCanvasCache() {
+    int x, y, width, height;
+    getCanvasPixelRect(x, y, width, height);
+    if (width <= 0 || height <= 0) return;
+
+    if (width != canvasCacheWidth || height != canvasCacheHeight) {
+        glBindTexture(GL_TEXTURE_2D, canvasTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, canvasFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, canvasTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        canvasCacheWidth = width;
+        canvasCacheHeight = height;
+        canvasCacheValid = false;
+        deleteAllCheckpoints(); // Snapshots are only valid for the size they were taken at
+    }
+    if (x != canvasCacheX || y != canvasCacheY) {
+        canvasCacheX = x;
+        canvasCacheY = y;
+        canvasCacheValid = false;
+        deleteAllCheckpoints();
+    }
+
+    collectRasterTimings();
+    if (canvasCacheValid && canvasCachedStrokes == document.strokes.size()) return;
+
+    beginCanvasCacheDraw();
+    if (!canvasCacheValid) {
+        discardCheckpointsAfter(document.strokes.size());
+        if (!canvasCheckpoints.empty()) {
+            restoreCanvasCheckpoint(canvasCheckpoints.back());
+            canvasCachedStrokes = canvasCheckpoints.back().strokeCount;
+        } else {
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glClearColor(BG_R, BG_G, BG_B, 1.0f);
+            canvasCachedStrokes = 0;
         }
+        strokesSinceCheckpoint = 0;
+        rasterWorkSinceCheckpointMs = 0.0;
+        canvasCacheValid = true;
     }
+
+    // Space snapshots out on long replays so they fit the budget instead of being thinned at once
+    size_t remaining = document.strokes.size() - canvasCachedStrokes;
+    size_t interval = std::max(checkpointStrokeInterval, remaining / std::max<size_t>(1, maxCanvasCheckpoints()));
+    while (canvasCachedStrokes < document.strokes.size()) {
+        size_t chunk = (strokesSinceCheckpoint < interval) ? interval - strokesSinceCheckpoint : 1;
+        size_t next = std::min(document.strokes.size(), canvasCachedStrokes + chunk);
+
+        beginRasterTiming();
+        drawStrokeRange(canvasCachedStrokes, next);
+        endRasterTiming();
+        strokesSinceCheckpoint += next - canvasCachedStrokes;
+        canvasCachedStrokes = next;
+
+        if (strokesSinceCheckpoint >= interval || rasterWorkSinceCheckpointMs >= checkpointWorkIntervalMs) {
+            takeCanvasCheckpoint();
+        }
+    }
+    endCanvasCacheDraw();
+}
+
+// Drawing logic: Composites the cached canvas layer as a single textured quad
+void drawCanvasCache() {
+    if (!canvasCacheValid) return;
+
+    float x0 = canvasCacheX * 2.0f / windowWidth - 1.0f;
+    float y0 = canvasCacheY * 2.0f / windowHeight - 1.0f;
+    float x1 = (canvasCacheX + canvasCacheWidth) * 2.0f / windowWidth - 1.0f;
+    float y1 = (canvasCacheY + canvasCacheHeight) * 2.0f / windowHeight - 1.0f;
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, canvasTexture);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // Layer is premultiplied
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(x0, y0);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(x1, y0);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(x1, y1);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(x0, y1);
+    glEnd();
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
 }
 
 // Drawing logic: Renders the preview for shapes (rectangle, circle, line) before final commit
@@ -912,7 +1539,7 @@ void drawShapePreview() {
 
 // Drawing logic: Renders the stroke that is currently being drawn (for brush/eraser)
 void drawCurrentStroke() {
-    if (!isDrawing || currentStroke.points.empty()) return;
+    if (!isDrawing || currentStroke.freehand.count == 0) return;
 
     if (currentTool == 1) { // Eraser
         // Eraser now draws with the canvas background color for seamless erasing
@@ -922,18 +1549,19 @@ void drawCurrentStroke() {
     }
 
     glPointSize(currentStroke.size);
+    auto emitVertices = [](const Point* points, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+            glVertex2f(points[i].x, points[i].y);
+        }
+    };
     glBegin(GL_POINTS);
-    for (const auto& point : currentStroke.points) {
-        glVertex2f(point.x, point.y);
-    }
+    forEachStrokeSpan(document, currentStroke, emitVertices);
     glEnd();
 
-    if (currentStroke.points.size() > 1) {
+    if (currentStroke.freehand.count > 1) {
         glLineWidth(currentStroke.size / 2.0f);
         glBegin(GL_LINE_STRIP);
-        for (const auto& point : currentStroke.points) {
-            glVertex2f(point.x, point.y);
-        }
+        forEachStrokeSpan(document, currentStroke, emitVertices);
         glEnd();
     }
 }
@@ -962,46 +1590,403 @@ void drawGrid() {
     glEnd();
 }
 
-// Function to save the canvas content as a JPG image
-void saveScreenshotAsJpg(const char* filename, int windowWidth_px, int windowHeight_px) {
-    // Calculate the canvas area in pixel coordinates
-    int canvas_x_pixel = static_cast<int>((SIDEBAR_RIGHT_GL + 1.0f) / 2.0f * windowWidth_px);
-    
-    // Convert DRAWING_AREA_BOTTOM_GL (OpenGL Y coord) to pixel Y coord (from bottom of window)
-    int canvas_y_pixel = static_cast<int>((DRAWING_AREA_BOTTOM_GL + 1.0f) / 2.0f * windowHeight_px);
-    
-    int canvas_width_pixel = static_cast<int>((1.0f - SIDEBAR_RIGHT_GL) / 2.0f * windowWidth_px);
-    int canvas_height_pixel = static_cast<int>((CANVAS_TOP_GL - DRAWING_AREA_BOTTOM_GL) / 2.0f * windowHeight_px); // Height relative to new bottom limit
+// --- Screenshot Export ---
+// Saving never waits on the GPU or the encoder. At the end of the next frame the canvas area is
+// read back into a pixel buffer object, which only queues the copy; a fence tells a later loop
+// iteration when it has landed. The pixels are then copied out and handed to the image writer
+// thread, which flips and encodes them. The status bar reports when the file is written.
+
+ImageWriter imageWriter;
+GLuint screenshotPbo = 0;
+GLsizeiptr screenshotPboSize = 0;
+GLsync screenshotFence = nullptr; // Set while a readback is in flight
+ImageJob screenshotJob; // Path and size of the readback in flight
+std::string screenshotRequest; // Path to capture at the end of the next frame, empty if none
+
+void requestScreenshot(const std::string& path) {
+    screenshotRequest = path;
+    showStatusMessage("Saving " + path + "...");
+}
+
+// Queues the readback of the canvas area from the frame just rendered (called by render())
+void captureScreenshot() {
+    if (screenshotRequest.empty() || screenshotFence) return; // One readback in flight at a time
+    int x, y, width, height;
+    getCanvasPixelRect(x, y, width, height);
+    if (width <= 0 || height <= 0) {
+        screenshotRequest.clear();
+        return;
+    }
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+    if (screenshotPbo == 0) glGenBuffers(1, &screenshotPbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, screenshotPbo);
+    if (size > screenshotPboSize) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        screenshotPboSize = size;
+    }
+    // RGBA rows are always 4-byte aligned, so the default pack alignment needs no padding
+    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    screenshotFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    screenshotJob = ImageJob();
+    screenshotJob.path = screenshotRequest;
+    screenshotJob.width = width;
+    screenshotJob.height = height;
+    screenshotJob.bottomUp = true;
+    screenshotRequest.clear();
+}
+
+// Called every loop iteration: hands a finished readback to the writer and shows its results
+void pollScreenshot() {
+    if (screenshotFence) {
+        GLenum state = glClientWaitSync(screenshotFence, 0, 0); // Zero timeout: never blocks
+        if (state == GL_ALREADY_SIGNALED || state == GL_CONDITION_SATISFIED || state == GL_WAIT_FAILED) {
+            glDeleteSync(screenshotFence);
+            screenshotFence = nullptr;
+            size_t size = static_cast<size_t>(screenshotJob.width) * screenshotJob.height * 4;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, screenshotPbo);
+            const void* mapped = (state != GL_WAIT_FAILED) ? glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT) : nullptr;
+            if (mapped) {
+                const uint8_t* bytes = static_cast<const uint8_t*>(mapped);
+                screenshotJob.pixels.assign(bytes, bytes + size);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                imageWriter.submit(std::move(screenshotJob));
+            } else {
+                showStatusMessage("Failed to read back " + screenshotJob.path);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        } else {
+            requestRedraw(); // Check again next frame
+        }
+    }
+    if (!screenshotRequest.empty()) requestRedraw(); // Waiting for the previous readback to finish
+
+    std::string message;
+    while (imageWriter.pollResult(message)) {
+        showStatusMessage(message);
+    }
+    if (!statusMessage.empty() && glfwGetTime() >= statusMessageUntil) {
+        statusMessage.clear();
+        requestRedraw();
+    }
+}
+
+// --- High-Resolution Export ---
+// Ctrl+Shift+S re-renders the canvas region from the stroke list with the CPU rasterizer, at
+// exportScale times the on-screen canvas resolution (or exportWidth pixels wide). It does not
+// depend on the window's pixels or a GL texture size limit: the rasterizer works in 128px tiles
+// over a plain memory image, one horizontal band at a time, and each band is streamed into the
+// PNG encoder, so memory stays bounded by the band even for gigapixel exports. The document is
+// copied first and the render runs on the image writer thread, so drawing can continue meanwhile.
+
+float exportScale = 4.0f; // Output pixels per on-screen canvas pixel (--export-scale N)
+int exportWidth = 0; // If set, overrides exportScale (--export-width PX)
+std::unique_ptr<ThreadPool> exportPool; // Created on first export; only used by the writer thread
+
+void exportHighRes(const std::string& path) {
+    int x, y, width, height;
+    getCanvasPixelRect(x, y, width, height);
+    if (width <= 0 || height <= 0) return;
+    float scale = exportWidth > 0 ? static_cast<float>(exportWidth) / width : exportScale;
+    int outputWidth = std::max(1, static_cast<int>(std::lround(width * scale)));
+    int outputHeight = std::max(1, static_cast<int>(std::lround(height * scale)));
+
+    RasterOptions options = canvasRasterOptions(static_cast<float>(outputWidth) / width);
+
+    std::shared_ptr<Document> snapshot = std::make_shared<Document>();
+    copyDocument(document, *snapshot);
+    if (!exportPool) exportPool.reset(new ThreadPool());
+    ThreadPool* pool = exportPool.get();
+
+    ImageJob job;
+    job.path = path;
+    job.width = outputWidth;
+    job.height = outputHeight;
+    // Each band is the matching horizontal slice of the canvas region, rendered on its own
+    auto rasterizer = std::make_shared<Rasterizer>(pool);
+    job.renderRows = [snapshot, options, rasterizer, outputWidth, outputHeight](int firstRow, int rowCount, std::vector<uint8_t>& rgba) {
+        RgbaImage band;
+        band.pixels.swap(rgba); // Reuse the band buffer
+        rasterizer->renderRows(*snapshot, options, outputWidth, outputHeight, firstRow, rowCount, band);
+        rgba.swap(band.pixels);
+        return true;
+    };
+    imageWriter.submit(std::move(job));
+    showStatusMessage("Exporting " + path + " (" + std::to_string(outputWidth) + "x" + std::to_string(outputHeight) + ")...");
+}
+
+void deleteScreenshotResources() {
+    if (screenshotFence) glDeleteSync(screenshotFence);
+    glDeleteBuffers(1, &screenshotPbo);
+}
+
+
+// --- Document Editing ---
+// All changes to the committed stroke list go through `history` and these helpers, so the
+// GPU copy, the cached canvas layer and the autosave journal stay in sync. Commits are picked
+// up incrementally by updateCanvasCache(); anything that removes strokes invalidates the layer.
+
+// Helper: Shrinks a finished freehand stroke before it is committed (curve fit, else RDP)
+void reduceFreehandStroke(Stroke& stroke) {
+    freehandSamplesIn += stroke.freehand.count;
+    CurveScale scale;
+    scale.pixelsPerUnitX = windowWidth / 2.0f;
+    scale.pixelsPerUnitY = windowHeight / 2.0f;
+    bool fitted = fitCurves && curveFitter.fit(document.arena, stroke.freehand, curveTolerancePx, scale);
+    if (!fitted && simplifyStrokes) {
+        SimplifySettings settings;
+        settings.tolerancePx = simplifyTolerancePx;
+        settings.pixelsPerUnitX = scale.pixelsPerUnitX;
+        settings.pixelsPerUnitY = scale.pixelsPerUnitY;
+        strokeSimplifier.simplify(document.arena, stroke.freehand, stroke.size, settings);
+    }
+    freehandPointsStored += stroke.freehand.count;
+}
+
+// Freehand strokes hand over their arena chain; shapes and fills are fully described by `stroke`
+void commitStroke(const Stroke& stroke) {
+    history.commit(stroke);
+    journal.recordCommit(document);
+    uploadStrokeGeometry(document.strokes.back());
+}
+
+// Bucket fill: floods the canvas pixels around a point that are (within fillTolerance) the
+// color of that point as currently drawn, and commits them as a run-length mask stroke
+void bucketFill(float glX, float glY) {
+    updateCanvasCache(); // Strokes committed since the last frame must be in the layer
+    int width = canvasCacheWidth, height = canvasCacheHeight;
+    if (width <= 0 || height <= 0) return;
+    int seedX = static_cast<int>((glX + 1.0f) / 2.0f * windowWidth) - canvasCacheX;
+    int seedY = static_cast<int>((glY + 1.0f) / 2.0f * windowHeight) - canvasCacheY;
+    seedX = std::max(0, std::min(width - 1, seedX));
+    seedY = std::max(0, std::min(height - 1, seedY));
+
+    fillReadback.resize(static_cast<size_t>(width) * height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, canvasFbo);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, fillReadback.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    // The layer is premultiplied over transparent; what shows through is the white canvas
+    for (size_t i = 0; i < fillReadback.size(); i += 4) {
+        uint8_t uncovered = 255 - fillReadback[i + 3];
+        fillReadback[i] += uncovered;
+        fillReadback[i + 1] += uncovered;
+        fillReadback[i + 2] += uncovered;
+    }
+
+    const std::vector<MaskRun>& runs = floodFiller.fill(fillReadback.data(), width, height, seedX, seedY, fillTolerance);
+    if (runs.empty()) return;
+    Stroke fillStroke;
+    fillStroke.tool = TOOL_MASK_FILL;
+    std::memcpy(fillStroke.color, currentColor, sizeof(fillStroke.color));
+    fillStroke.mask.mask = document.masks.add(std::vector<MaskRun>(runs));
+    fillStroke.mask.runCount = static_cast<uint32_t>(runs.size());
+    fillStroke.mask.origin = Point(canvasCacheX * 2.0f / windowWidth - 1.0f, canvasCacheY * 2.0f / windowHeight - 1.0f);
+    fillStroke.mask.pixelWidth = 2.0f / windowWidth;
+    fillStroke.mask.pixelHeight = 2.0f / windowHeight;
+    commitStroke(fillStroke);
+}
+
+// Redraws only the part of the cached layer that a just-undone stroke covered: the area is
+// cleared and every remaining stroke the spatial index finds there is drawn again, in order.
+// Returns false (the caller then rebuilds from a checkpoint) when that would draw more strokes
+// than replaying from the newest checkpoint.
+bool repaintCanvasRegion(const Bounds& removed, float removedSize) {
+    if (!canvasCacheValid || canvasCachedStrokes != document.strokes.size() + 1) return false;
+
+    // Ink reaches half the stroke size (plus antialiasing) past its geometric bounds
+    float pixelsPerUnitX = windowWidth / 2.0f, pixelsPerUnitY = windowHeight / 2.0f;
+    float removedPad = removedSize / 2.0f + 2.0f;
+    Bounds dirty = removed.padded(removedPad / pixelsPerUnitX, removedPad / pixelsPerUnitY);
+    float reach = document.index.maxStrokeSize() / 2.0f + 2.0f;
+    document.index.queryRect(dirty.padded(reach / pixelsPerUnitX, reach / pixelsPerUnitY), strokeQueryScratch);
+
+    size_t replayFrom = canvasCheckpoints.empty() ? 0 : canvasCheckpoints.back().strokeCount;
+    if (strokeQueryScratch.size() >= document.strokes.size() - replayFrom) return false;
+
+    // Dirty area in canvas texture pixels
+    int x0 = static_cast<int>(std::floor((dirty.minX + 1.0f) * pixelsPerUnitX)) - canvasCacheX;
+    int y0 = static_cast<int>(std::floor((dirty.minY + 1.0f) * pixelsPerUnitY)) - canvasCacheY;
+    int x1 = static_cast<int>(std::ceil((dirty.maxX + 1.0f) * pixelsPerUnitX)) - canvasCacheX;
+    int y1 = static_cast<int>(std::ceil((dirty.maxY + 1.0f) * pixelsPerUnitY)) - canvasCacheY;
+    x0 = std::max(0, x0); y0 = std::max(0, y0);
+    x1 = std::min(canvasCacheWidth, x1); y1 = std::min(canvasCacheHeight, y1);
+
+    beginCanvasCacheDraw();
+    if (x0 < x1 && y0 < y1) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x0, y0, x1 - x0, y1 - y0);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(BG_R, BG_G, BG_B, 1.0f);
+        // Consecutive indices are drawn as one range so batches stay intact
+        size_t i = 0;
+        while (i < strokeQueryScratch.size()) {
+            size_t j = i + 1;
+            while (j < strokeQueryScratch.size() && strokeQueryScratch[j] == strokeQueryScratch[j - 1] + 1) ++j;
+            drawStrokeRange(strokeQueryScratch[i], strokeQueryScratch[j - 1] + 1);
+            i = j;
+        }
+        glDisable(GL_SCISSOR_TEST);
+    }
+    endCanvasCacheDraw();
+    canvasCachedStrokes = document.strokes.size();
+    return true;
+}
+
+// Helper: Re-uploads every stroke after the whole document was swapped by undo/redo of a clear
+void reloadStrokeGeometry() {
+    resetStrokeGeometry();
+    for (const auto& stroke : document.strokes) {
+        uploadStrokeGeometry(stroke);
+    }
+    discardCheckpointsAfter(0);
+    invalidateCanvasCache();
+}
+
+void undoLastEdit() {
+    Bounds undoneBounds = {0.0f, 0.0f, 0.0f, 0.0f};
+    float undoneSize = 0.0f;
+    if (!document.strokes.empty()) {
+        undoneBounds = document.index.bounds(static_cast<uint32_t>(document.strokes.size() - 1));
+        undoneSize = document.strokes.back().size;
+    }
+
+    switch (history.undo()) {
+        case HistoryAction::Commit:
+            journal.recordPop();
+            removeLastStrokeGeometry();
+            discardCheckpointsAfter(document.strokes.size());
+            if (!repaintCanvasRegion(undoneBounds, undoneSize)) {
+                invalidateCanvasCache(); // Rebuilt from the nearest checkpoint on the next frame
+            }
+            break;
+        case HistoryAction::Clear:
+            journal.compact(document); // The restored strokes are not in the journal any more
+            reloadStrokeGeometry();
+            break;
+        case HistoryAction::None:
+            break;
+    }
+}
+
+void redoLastEdit() {
+    switch (history.redo()) {
+        case HistoryAction::Commit:
+            journal.recordCommit(document);
+            uploadStrokeGeometry(document.strokes.back()); // Drawn incrementally like a new commit
+            break;
+        case HistoryAction::Clear:
+            journal.recordClear();
+            reloadStrokeGeometry();
+            break;
+        case HistoryAction::None:
+            break;
+    }
+}
 
-    // Allocate buffer for RGB data (3 bytes per pixel)
-    std::vector<unsigned char> pixels(canvas_width_pixel * canvas_height_pixel * 3);
+// Clearing is an undoable edit; the old strokes are kept in history, not freed
+void clearStrokes() {
+    if (history.clear()) {
+        journal.recordClear();
+        reloadStrokeGeometry();
+    }
+}
 
-    // Read pixels from the frame buffer.
-    glReadPixels(canvas_x_pixel, canvas_y_pixel, canvas_width_pixel, canvas_height_pixel, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
 
-    // OpenGL reads pixels from bottom-left, but image formats like JPG usually expect top-left.
-    // Need to flip the image vertically.
-    std::vector<unsigned char> flipped_pixels(canvas_width_pixel * canvas_height_pixel * 3);
-    int row_size = canvas_width_pixel * 3;
-    for (int y = 0; y < canvas_height_pixel; ++y) {
-        // Copy rows from bottom to top into the flipped_pixels buffer from top to bottom
-        std::memcpy(&flipped_pixels[(canvas_height_pixel - 1 - y) * row_size], &pixels[y * row_size], row_size);
+// --- Document Files ---
+// Ctrl+S saves the drawing as a .smk document and Ctrl+O reopens it. Opening maps the file
+// and replaces the document (and its undo history) wholesale; freehand points are read from
+// the mapping as strokes are drawn rather than copied up front.
+
+std::string documentPath = "sketchmate_drawing.smk"; // --document PATH
+bool compressDocuments = false; // Save points encoded: smaller files, but loading decodes them (--compress-documents)
+// Autosave keeps <autosavePath>.smk and <autosavePath>.journal (see journal.h) and restores
+// them on the next start
+std::string autosavePath = "sketchmate_autosave"; // --autosave PATH
+bool autosaveEnabled = true; // --no-autosave
+
+void saveDocumentFile() {
+#ifdef _WIN32
+    // A file that is still mapped cannot be replaced on Windows: copy its points out first
+    document.arena.internalize();
+#endif
+    std::string error;
+    SaveOptions options;
+    options.compressPoints = compressDocuments;
+    if (saveDocument(document, documentPath, error, options)) {
+        showStatusMessage("Saved " + documentPath);
+    } else {
+        showStatusMessage("Save failed: " + error);
     }
+}
 
-    // Save as JPG using stb_image_write
-    if (stbi_write_jpg(filename, canvas_width_pixel, canvas_height_pixel, 3, flipped_pixels.data(), 90)) {
-        std::cout << "Screenshot saved to " << filename << std::endl;
+void openDocumentFile() {
+    DocumentFile file;
+    std::string error;
+    if (!file.open(documentPath, error)) {
+        showStatusMessage("Open failed: " + error);
+        return;
+    }
+    isDrawing = false; // The stroke in progress lives in the arena that is about to be reset
+    currentStroke.freehand = PointArena::emptyRef();
+    history.reset();
+    resetDocument(document);
+    file.load(document);
+    journal.compact(document);
+    reloadStrokeGeometry();
+    showStatusMessage("Opened " + documentPath + " (" + std::to_string(file.strokeCount()) + " strokes)");
+}
+
+// --- Input Recording ---
+// --record FILE logs every input event and frame (input_log.h); --replay FILE feeds such a log
+// back through the same callbacks instead of the real input, at the recorded pace or, with
+// --replay-fast, as fast as frames can be drawn. --headless replays in a hidden window and
+// exits at the end of the log, printing frame timings.
+
+std::string recordPath; // --record FILE
+std::string replayPath; // --replay FILE
+bool replayFast = false; // --replay-fast
+bool headless = false; // --headless
+InputRecorder inputRecorder;
+InputReplay inputReplay;
+bool replayRunning = false;
+double replayStartTime = 0.0;
+double replayCursorX = 0.0, replayCursorY = 0.0; // Cursor position as of the last replayed event
+std::vector<double> replayFrameMs; // Render + swap time of every replayed frame
+
+// Helper: Cursor position in window pixels; during a replay, the recorded one
+void getCursorPos(GLFWwindow* window, double& x, double& y) {
+    if (replayRunning) {
+        x = replayCursorX;
+        y = replayCursorY;
     } else {
-        std::cerr << "Failed to save screenshot to " << filename << std::endl;
+        glfwGetCursorPos(window, &x, &y);
     }
 }
 
+// Helper: Appends an event to the input log, if recording
+void recordInput(InputEvent event) {
+    if (!inputRecorder.isOpen()) return;
+    event.time = glfwGetTime();
+    if (!inputRecorder.record(event)) showStatusMessage("Input recording stopped: cannot write " + recordPath);
+}
 
 // --- Event Handlers ---
 
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    requestRedraw();
     double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
+    getCursorPos(window, xpos, ypos);
+    InputEvent event;
+    event.type = INPUT_MOUSE_BUTTON;
+    event.code = button;
+    event.action = action;
+    event.mods = mods;
+    event.x = xpos;
+    event.y = ypos;
+    recordInput(event);
     float glX, glY;
     screenToGL(xpos, ypos, glX, glY);
 
@@ -1037,7 +2022,7 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
                 float clear_btn_x = 1.0f - PADDING_X_GL - clear_btn_w;
                 float clear_btn_y = 1.0f - PADDING_Y_GL - clear_btn_h;
                 if (glX >= clear_btn_x && glX <= clear_btn_x + clear_btn_w && glY >= clear_btn_y && glY <= clear_btn_y + clear_btn_h) {
-                    strokes.clear();
+                    clearStrokes();
                     handledClick = true;
                 }
 
@@ -1048,7 +2033,7 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
                 float save_btn_y = clear_btn_y; // Same vertical position
 
                 if (glX >= save_btn_x && glX <= save_btn_x + save_btn_w && glY >= save_btn_y && glY <= save_btn_y + save_btn_h) {
-                    saveScreenshotAsJpg("sketchmate_drawing.jpg", windowWidth, windowHeight);
+                    requestScreenshot("sketchmate_drawing.jpg");
                     handledClick = true;
                 }
             }
@@ -1142,55 +2127,21 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
                 float clampedGlX = std::max(SIDEBAR_RIGHT_GL, std::min(1.0f, glX));
                 float clampedGlY = std::max(DRAWING_AREA_BOTTOM_GL, std::min(CANVAS_TOP_GL, glY));
 
-                if (currentTool == 5) { // Handle Fill tool specifically
-                    bool filledExistingShape = false;
-                    for (int i = strokes.size() - 1; i >= 0; --i) {
-                        const Stroke& existingStroke = strokes[i];
-                        if (existingStroke.tool == 2) { // Rectangle
-                            float minX = std::min(existingStroke.points[0].x, existingStroke.points[2].x);
-                            float maxX = std::max(existingStroke.points[0].x, existingStroke.points[2].x);
-                            float minY = std::min(existingStroke.points[0].y, existingStroke.points[2].y);
-                            float maxY = std::max(existingStroke.points[0].y, existingStroke.points[2].y);
-
-                            if (clampedGlX >= minX && clampedGlX <= maxX && clampedGlY >= minY && clampedGlY <= maxY) {
-                                Stroke fillStroke;
-                                fillStroke.tool = 5;
-                                std::memcpy(fillStroke.fillColor, currentColor, sizeof(fillStroke.fillColor));
-                                fillStroke.rectStart = Point(minX, minY);
-                                fillStroke.rectEnd = Point(maxX, maxY);
-                                fillStroke.circleRadius = 0;
-                                strokes.push_back(fillStroke);
-                                filledExistingShape = true;
-                                break;
-                            }
-                        } else if (existingStroke.tool == 3) { // Circle
-                            if (existingStroke.circleRadius > 0) {
-                                float dist_sq = std::pow(clampedGlX - existingStroke.circleCenter.x, 2) + std::pow(clampedGlY - existingStroke.circleCenter.y, 2);
-                                if (dist_sq <= std::pow(existingStroke.circleRadius, 2)) {
-                                    Stroke fillStroke;
-                                    fillStroke.tool = 5;
-                                    std::memcpy(fillStroke.fillColor, currentColor, sizeof(fillStroke.fillColor));
-                                    fillStroke.circleCenter = existingStroke.circleCenter;
-                                    fillStroke.circleRadius = existingStroke.circleRadius;
-                                    strokes.push_back(fillStroke);
-                                    filledExistingShape = true;
-                                    break;
-                                }
-                            }
-                        }
-                    }
+                if (currentTool == 5) { // Fill tool: bucket fill of the area around the click
+                    bucketFill(clampedGlX, clampedGlY);
                     isDrawing = false; 
                 } else { // Other tools (Brush, Eraser, Shapes)
                     isDrawing = true;
                     // Initial point for drawing
                     if (currentTool < 2) { // Brush or Eraser
-                        currentStroke.points.clear();
+                        document.arena.release(currentStroke.freehand); // Drop any abandoned samples
                         currentStroke.tool = currentTool;
                         currentStroke.size = (currentTool == 0) ? brushSize : eraserSize;
-                        currentStroke.points.push_back(Point(clampedGlX, clampedGlY, currentColor[0], currentColor[1], currentColor[2]));
+                        std::memcpy(currentStroke.color, currentColor, sizeof(currentStroke.color));
+                        document.arena.append(currentStroke.freehand, Point(clampedGlX, clampedGlY));
                     }
                     // Start point for shapes
-                    shapeStart = Point(clampedGlX, clampedGlY, currentColor[0], currentColor[1], currentColor[2]);
+                    shapeStart = Point(clampedGlX, clampedGlY);
                     shapeEnd = shapeStart; // Initialize shapeEnd to shapeStart
                 }
             }
@@ -1208,28 +2159,27 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
             screenToGL(xpos, ypos, finalGlX, finalGlY);
             finalGlX = std::max(SIDEBAR_RIGHT_GL, std::min(1.0f, finalGlX));
             finalGlY = std::max(DRAWING_AREA_BOTTOM_GL, std::min(CANVAS_TOP_GL, finalGlY));
-            shapeEnd = Point(finalGlX, finalGlY, currentColor[0], currentColor[1], currentColor[2]);
+            shapeEnd = Point(finalGlX, finalGlY);
 
             if (currentTool < 2) { // Brush or Eraser
                 // Only add stroke if there are points
-                if (!currentStroke.points.empty()) {
-                    strokes.push_back(currentStroke);
+                if (currentStroke.freehand.count > 0) {
+                    reduceFreehandStroke(currentStroke);
+                    commitStroke(currentStroke); // The document now owns the chain
                 }
-                currentStroke.points.clear();
+                currentStroke.freehand = PointArena::emptyRef();
             } else if (currentTool >= 2 && currentTool <= 4) { // Shapes
                 Stroke newStroke;
                 newStroke.tool = currentTool;
                 newStroke.size = brushSize; // Shapes use brushSize for outline thickness
+                std::memcpy(newStroke.color, currentColor, sizeof(newStroke.color));
                 
                 // Only add shape if it's not a tiny point click
                 if (std::abs(shapeStart.x - shapeEnd.x) > 0.001f || std::abs(shapeStart.y - shapeEnd.y) > 0.001f) {
                     switch (currentTool) {
                         case 2: // Rectangle
-                            newStroke.points.push_back(Point(shapeStart.x, shapeStart.y, currentColor[0], currentColor[1], currentColor[2]));
-                            newStroke.points.push_back(Point(shapeEnd.x, shapeStart.y, currentColor[0], currentColor[1], currentColor[2]));
-                            newStroke.points.push_back(Point(shapeEnd.x, shapeEnd.y, currentColor[0], currentColor[1], currentColor[2]));
-                            newStroke.points.push_back(Point(shapeStart.x, shapeEnd.y, currentColor[0], currentColor[1], currentColor[2]));
-                            newStroke.points.push_back(Point(shapeStart.x, shapeStart.y, currentColor[0], currentColor[1], currentColor[2])); // Close the loop
+                            newStroke.rect.start = shapeStart;
+                            newStroke.rect.end = shapeEnd;
                             break;
                         case 3: // Circle
                             {
@@ -1243,24 +2193,16 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
                                 float maxRadiusY = std::min(shapeStart.y - canvasMinY, canvasMaxY - shapeStart.y);
                                 radius = std::min({radius, maxRadiusX, maxRadiusY});
                                 radius = std::max(0.0f, radius); // Ensure radius is non-negative
-                                newStroke.circleCenter = shapeStart;
-                                newStroke.circleRadius = radius;
-                                for (int i = 0; i <= 360; i += 5) { 
-                                    float angle = i * M_PI / 180.0f;
-                                    float x_pt = shapeStart.x + radius * std::cos(angle);
-                                    float y_pt = shapeStart.y + radius * std::sin(angle);
-                                    newStroke.points.push_back(Point(x_pt, y_pt, currentColor[0], currentColor[1], currentColor[2]));
-                                }
+                                newStroke.circle.center = shapeStart;
+                                newStroke.circle.radius = radius;
                             }
                             break;
                         case 4: // Line
-                            newStroke.points.push_back(Point(shapeStart.x, shapeStart.y, currentColor[0], currentColor[1], currentColor[2]));
-                            newStroke.points.push_back(Point(shapeEnd.x, shapeEnd.y, currentColor[0], currentColor[1], currentColor[2]));
+                            newStroke.line.start = shapeStart;
+                            newStroke.line.end = shapeEnd;
                             break;
                     }
-                    if (!newStroke.points.empty()) {
-                        strokes.push_back(newStroke);
-                    }
+                    commitStroke(newStroke);
                 }
             }
             isDrawing = false;
@@ -1269,6 +2211,12 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 }
 
 void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
+    requestRedraw(); // Hover highlights and in-progress strokes follow the cursor
+    InputEvent event;
+    event.type = INPUT_CURSOR_POS;
+    event.x = xpos;
+    event.y = ypos;
+    recordInput(event);
     float glX, glY;
     screenToGL(xpos, ypos, glX, glY);
 
@@ -1314,19 +2262,27 @@ void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
         glY = std::max(DRAWING_AREA_BOTTOM_GL, std::min(CANVAS_TOP_GL, glY)); // Use the new constant
 
         if (currentTool < 2) { // Brush or Eraser
-            if (currentStroke.points.empty()) { 
-                currentStroke.points.push_back(shapeStart); // Ensure starting point is added
+            if (currentStroke.freehand.count == 0) { 
+                document.arena.append(currentStroke.freehand, shapeStart); // Ensure starting point is added
             }
-            currentStroke.points.push_back(Point(glX, glY, currentColor[0], currentColor[1], currentColor[2]));
+            document.arena.append(currentStroke.freehand, Point(glX, glY));
         } else if (currentTool >= 2 && currentTool <= 5) { // Shapes or Fill
-            shapeEnd = Point(glX, glY, currentColor[0], currentColor[1], currentColor[2]);
+            shapeEnd = Point(glX, glY);
         }
     }
 }
 
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+    requestRedraw();
     double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
+    getCursorPos(window, xpos, ypos);
+    InputEvent event;
+    event.type = INPUT_SCROLL;
+    event.x = xpos;
+    event.y = ypos;
+    event.scrollX = xoffset;
+    event.scrollY = yoffset;
+    recordInput(event);
     float glX, glY;
     screenToGL(xpos, ypos, glX, glY);
 
@@ -1350,30 +2306,139 @@ void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    requestRedraw();
+    InputEvent event;
+    event.type = INPUT_KEY;
+    event.code = key;
+    event.scancode = scancode;
+    event.action = action;
+    event.mods = mods;
+    recordInput(event);
     if (action == GLFW_PRESS) {
-        if (key == GLFW_KEY_Z && (mods & GLFW_MOD_CONTROL || mods & GLFW_MOD_SUPER)) {
-            if (!strokes.empty()) {
-                strokes.pop_back();
-            }
-        } else if (key == GLFW_KEY_C && (mods & GLFW_MOD_CONTROL || mods & GLFW_MOD_SUPER)) {
-            strokes.clear();
+        bool ctrl = (mods & GLFW_MOD_CONTROL) || (mods & GLFW_MOD_SUPER);
+        if (key == GLFW_KEY_S && ctrl && (mods & GLFW_MOD_SHIFT)) {
+            exportHighRes("sketchmate_export.png"); // Ctrl+Shift+S
+        } else if (key == GLFW_KEY_S && ctrl) {
+            saveDocumentFile();
+        } else if (key == GLFW_KEY_O && ctrl) {
+            openDocumentFile();
+        } else if (key == GLFW_KEY_Z && ctrl && (mods & GLFW_MOD_SHIFT)) {
+            redoLastEdit(); // Ctrl+Shift+Z
+        } else if (key == GLFW_KEY_Z && ctrl) {
+            undoLastEdit();
+        } else if (key == GLFW_KEY_Y && ctrl) {
+            redoLastEdit();
+        } else if (key == GLFW_KEY_C && ctrl) {
+            clearStrokes();
         } else if (key == GLFW_KEY_B) {
             currentTool = 0; // Brush
         } else if (key == GLFW_KEY_E) {
             currentTool = 1; // Eraser
         } else if (key == GLFW_KEY_G) {
             showGrid = !showGrid; // Toggle grid
+        } else if (key == GLFW_KEY_F3) {
+            toggleProfilerHud();
+        }
+    }
+}
+
+void windowSizeCallback(GLFWwindow* window, int width, int height) {
+    requestRedraw();
+    InputEvent event;
+    event.type = INPUT_WINDOW_SIZE;
+    event.width = width;
+    event.height = height;
+    recordInput(event);
+}
+
+void windowRefreshCallback(GLFWwindow* window) {
+    requestRedraw(); // Window was uncovered/restored and its contents are damaged
+}
+
+void installInputCallbacks(GLFWwindow* window) {
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetScrollCallback(window, scrollCallback);
+    glfwSetKeyCallback(window, keyCallback); // For undo functionality
+    glfwSetWindowSizeCallback(window, windowSizeCallback);
+}
+
+// Feeds recorded events to the callbacks, up to the next recorded frame. At the recorded pace
+// it stops at the first event that is not due yet (after waiting for it, handling window events
+// meanwhile). Returns true when a frame is due.
+bool replayUntilFrame(GLFWwindow* window) {
+    glfwPollEvents(); // Keeps the window responsive; the real input callbacks are not installed
+    while (true) {
+        double elapsed = glfwGetTime() - replayStartTime;
+        const InputEvent* event = inputReplay.poll(elapsed, replayFast);
+        if (!event) {
+            if (inputReplay.isActive()) glfwWaitEventsTimeout(std::max(0.0, inputReplay.nextEventTime() - elapsed));
+            return false;
         }
+        switch (event->type) {
+            case INPUT_MOUSE_BUTTON:
+                replayCursorX = event->x;
+                replayCursorY = event->y;
+                mouseButtonCallback(window, event->code, event->action, event->mods);
+                break;
+            case INPUT_CURSOR_POS:
+                replayCursorX = event->x;
+                replayCursorY = event->y;
+                cursorPosCallback(window, event->x, event->y);
+                break;
+            case INPUT_SCROLL:
+                replayCursorX = event->x;
+                replayCursorY = event->y;
+                scrollCallback(window, event->scrollX, event->scrollY);
+                break;
+            case INPUT_KEY:
+                keyCallback(window, event->code, event->scancode, event->action, event->mods);
+                break;
+            case INPUT_WINDOW_SIZE:
+                windowWidth = std::max(1, event->width);
+                windowHeight = std::max(1, event->height);
+                glfwSetWindowSize(window, windowWidth, windowHeight);
+                windowSizeCallback(window, event->width, event->height);
+                break;
+            case INPUT_FRAME:
+                return true;
+        }
+    }
+}
+
+// Prints the replay's timings, then hands the window back to the user (or closes it when headless)
+void finishReplay(GLFWwindow* window) {
+    replayRunning = false;
+    double seconds = glfwGetTime() - replayStartTime;
+    std::vector<double> sorted(replayFrameMs);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ms : sorted) total += ms;
+    std::stringstream ss;
+    ss.precision(2);
+    ss << std::fixed << "Replayed " << inputReplay.eventCount() << " events, " << sorted.size() << " frames in " << seconds << " s";
+    if (!sorted.empty()) {
+        ss << ": frame mean " << total / sorted.size() << " ms, p95 " << sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)]
+           << " ms, max " << sorted.back() << " ms";
+    }
+    showStatusMessage(ss.str());
+    if (frameProfiler.enabled()) std::cout << frameProfiler.report();
+    if (headless) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    } else {
+        installInputCallbacks(window);
     }
 }
 
 // --- Main Rendering Function ---
-void render() {
+
+// Clears the window and draws the panels, top bar and sidebar around the canvas
+void drawChrome() {
     glClearColor(BG_R, BG_G, BG_B, 1.0f); // Set clear color to the new background
     glClear(GL_COLOR_BUFFER_BIT);
 
     double mouseX, mouseY;
-    glfwGetCursorPos(glfwGetCurrentContext(), &mouseX, &mouseY);
+    getCursorPos(glfwGetCurrentContext(), mouseX, mouseY);
     float mouseX_gl, mouseY_gl;
     screenToGL(mouseX, mouseY, mouseX_gl, mouseY_gl);
 
@@ -1425,38 +2490,151 @@ void render() {
     glEnd();
 
     drawSizeSelectorsSidebar(section_y_pos.sizesSectionTopY, mouseX_gl, mouseY_gl);
+}
+
+// Draws one frame; each phase is timed for the profiler HUD
+void render() {
+    {
+        FramePhaseScope phase(PHASE_CANVAS_UPDATE);
+        // Curve strokes were flattened for the window size at upload time; re-flatten after a resize
+        if (windowWidth != strokeGeometryWidth || windowHeight != strokeGeometryHeight) {
+            strokeGeometryWidth = windowWidth;
+            strokeGeometryHeight = windowHeight;
+            if (!document.strokes.empty()) reloadStrokeGeometry();
+        }
+        updateCanvasCache(); // Draw any newly committed strokes into the cached layer first
+    }
+    {
+        FramePhaseScope phase(PHASE_CHROME);
+        drawChrome();
+    }
 
     // --- Enable Scissor Test for Canvas Drawing ---
     // Scissor test defines a rectangular region to which all subsequent drawing is clipped.
     // x, y specify the lower-left corner of the scissor box in pixels.
     // width, height specify the width and height of the scissor box in pixels.
-    int scissor_x_pixel = static_cast<int>((SIDEBAR_RIGHT_GL + 1.0f) / 2.0f * windowWidth);
-    int scissor_y_pixel = static_cast<int>((DRAWING_AREA_BOTTOM_GL + 1.0f) / 2.0f * windowHeight); // Bottom of drawing area in pixels
-    int scissor_width_pixel = static_cast<int>((1.0f - SIDEBAR_RIGHT_GL) / 2.0f * windowWidth);
-    int scissor_height_pixel = static_cast<int>((CANVAS_TOP_GL - DRAWING_AREA_BOTTOM_GL) / 2.0f * windowHeight); // Height from DRAWING_AREA_BOTTOM_GL to CANVAS_TOP_GL
+    int scissor_x_pixel, scissor_y_pixel, scissor_width_pixel, scissor_height_pixel;
+    getCanvasPixelRect(scissor_x_pixel, scissor_y_pixel, scissor_width_pixel, scissor_height_pixel);
 
     glEnable(GL_SCISSOR_TEST);
     glScissor(scissor_x_pixel, scissor_y_pixel, scissor_width_pixel, scissor_height_pixel);
 
     // Draw Canvas elements
-    drawGrid(); // Draw grid if enabled
-    drawStrokes();
-    drawCurrentStroke();
-    drawShapePreview();
+    {
+        FramePhaseScope phase(PHASE_GRID);
+        drawGrid(); // Draw grid if enabled
+    }
+    {
+        FramePhaseScope phase(PHASE_STROKES);
+        drawCanvasCache(); // All committed strokes, as one textured quad
+    }
+    {
+        FramePhaseScope phase(PHASE_CURRENT_STROKE);
+        drawCurrentStroke();
+    }
+    {
+        FramePhaseScope phase(PHASE_PREVIEW);
+        drawShapePreview();
+    }
 
     glDisable(GL_SCISSOR_TEST);
 
+    {
+        FramePhaseScope phase(PHASE_CAPTURE);
+        captureScreenshot(); // Canvas area as it is on screen, before the status bar covers the corner
+    }
+
     // Draw Status Bar (always on top of other elements)
+    FramePhaseScope phase(PHASE_STATUS_BAR);
     drawStatusBar();
+    drawProfilerHud();
+}
+
+// Parses the optional flags: --continuous, --swap-interval N, --fps-cap N, --history-limit-mb N,
+// --no-curves, --curve-tolerance PX, --no-simplify, --simplify-tolerance PX, --fill-tolerance N,
+// --export-scale N, --export-width PX, --document PATH, --compress-documents, --autosave PATH,
+// --no-autosave, --no-history-compression, --record FILE, --replay FILE, --replay-fast, --headless,
+// --profile
+void parseCommandLine(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--continuous") {
+            eventDrivenLoop = false;
+        } else if (arg == "--swap-interval" && i + 1 < argc) {
+            swapInterval = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--fps-cap" && i + 1 < argc) {
+            maxFrameRate = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--history-limit-mb" && i + 1 < argc) {
+            history.setMemoryLimit(static_cast<size_t>(std::max(0.0, std::atof(argv[++i])) * 1024.0 * 1024.0));
+        } else if (arg == "--no-curves") {
+            fitCurves = false;
+        } else if (arg == "--curve-tolerance" && i + 1 < argc) {
+            curveTolerancePx = std::max(0.05f, static_cast<float>(std::atof(argv[++i])));
+        } else if (arg == "--no-simplify") {
+            simplifyStrokes = false;
+        } else if (arg == "--simplify-tolerance" && i + 1 < argc) {
+            simplifyTolerancePx = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+        } else if (arg == "--fill-tolerance" && i + 1 < argc) {
+            fillTolerance = std::max(0, std::min(255, std::atoi(argv[++i])));
+        } else if (arg == "--export-scale" && i + 1 < argc) {
+            exportScale = std::max(0.1f, static_cast<float>(std::atof(argv[++i])));
+        } else if (arg == "--export-width" && i + 1 < argc) {
+            exportWidth = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--document" && i + 1 < argc) {
+            documentPath = argv[++i];
+        } else if (arg == "--autosave" && i + 1 < argc) {
+            autosavePath = argv[++i];
+        } else if (arg == "--no-autosave") {
+            autosaveEnabled = false;
+        } else if (arg == "--compress-documents") {
+            compressDocuments = true;
+        } else if (arg == "--no-history-compression") {
+            history.setCompressCleared(false);
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--replay-fast") {
+            replayFast = true;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--profile") {
+            frameProfiler.setEnabled(true);
+        } else {
+            std::cerr << "Ignoring unknown argument: " << arg << std::endl;
+        }
+    }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    parseCommandLine(argc, argv);
+
     // Initialize GLFW (Graphics Library Framework)
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
 
+    if (!replayPath.empty()) {
+        std::string error;
+        if (!inputReplay.open(replayPath, error)) {
+            std::cerr << "Cannot replay: " << error << std::endl;
+            return -1;
+        }
+        if (inputReplay.truncated()) std::cerr << replayPath << " ends in a torn record; replaying what precedes it" << std::endl;
+        // The log starts from the window it was recorded in, on an empty canvas
+        if (inputReplay.windowWidth() > 0 && inputReplay.windowHeight() > 0) {
+            windowWidth = inputReplay.windowWidth();
+            windowHeight = inputReplay.windowHeight();
+        }
+        autosaveEnabled = false;
+        if (replayFast || headless) swapInterval = 0;
+    } else if (headless) {
+        std::cerr << "--headless only applies to --replay" << std::endl;
+        headless = false;
+    }
+    if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
     // Create a GLFW window
     GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "SketchMate", nullptr, nullptr);
     if (!window) {
@@ -1465,6 +2643,7 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window); // Make the window's context current on the calling thread
+    glfwSwapInterval(swapInterval); // Vsync setting for buffer swaps
 
     // Initialize GLAD (OpenGL Loader-Generator) to load OpenGL function pointers
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -1472,11 +2651,9 @@ int main() {
         return -1;
     }
 
-    // Set up callback functions for user input
-    glfwSetMouseButtonCallback(window, mouseButtonCallback);
-    glfwSetCursorPosCallback(window, cursorPosCallback);
-    glfwSetScrollCallback(window, scrollCallback);
-    glfwSetKeyCallback(window, keyCallback); // For undo functionality
+    // Set up callback functions for user input (a replay installs them once it is done)
+    if (replayPath.empty()) installInputCallbacks(window);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
     
     // Set the clear color for the window background to white
     glClearColor(BG_R, BG_G, BG_B, 1.0f); 
@@ -1489,15 +2666,102 @@ int main() {
     glEnable(GL_BLEND); // Enable blending for transparency and anti-aliasing effects
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Standard blending function
 
+    initStrokeGeometry(); // GPU buffer for committed strokes
+    initCanvasCache(); // Offscreen layer holding the rasterized strokes
+    initCanvasCheckpoints(); // Snapshots of that layer for fast undo
+    initGpuTimers(); // For the profiler HUD
+    imageWriter.setOnFinished([] { glfwPostEmptyEvent(); }); // Wake the loop to show the result
+    if (autosaveEnabled) {
+        // Geometry for recovered strokes is uploaded by the first render()
+        size_t recovered = journal.open(autosavePath, document);
+        if (recovered > 0) showStatusMessage("Recovered " + std::to_string(recovered) + " strokes from the last session");
+    }
+    if (!recordPath.empty()) {
+        // Replaying reproduces this session exactly only if it also starts from an empty canvas
+        std::string error;
+        if (!inputRecorder.open(recordPath, windowWidth, windowHeight, static_cast<uint32_t>(document.strokes.size()), glfwGetTime(), error)) {
+            showStatusMessage("Cannot record input: " + error);
+        } else if (!document.strokes.empty()) {
+            showStatusMessage("Recording input to " + recordPath + " (starting with " + std::to_string(document.strokes.size()) + " strokes)");
+        }
+    }
+    if (!replayPath.empty()) {
+        if (inputReplay.initialStrokes() > 0) {
+            showStatusMessage(replayPath + " was recorded on top of " + std::to_string(inputReplay.initialStrokes()) + " strokes; replaying on an empty canvas");
+        }
+        replayRunning = true;
+        replayStartTime = glfwGetTime();
+    }
+
     // Main application loop
+    // When idle the loop blocks in glfwWaitEventsTimeout, so it uses no CPU/GPU until input arrives.
+    // When a frame is wanted but the frame cap has not elapsed yet, it keeps processing events
+    // until the deadline, so input is never delayed by more than one frame interval.
+    // A replay instead draws its frames exactly where the recording drew them.
+    double lastFrameTime = 0.0;
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents(); // Process all pending events (input, window events)
-        glfwGetWindowSize(window, &windowWidth, &windowHeight); // Get current window size
+        if (replayRunning && !inputReplay.isActive()) finishReplay(window);
+        double frameInterval = (maxFrameRate > 0.0) ? 1.0 / maxFrameRate : 0.0;
+        double nextFrameTime = lastFrameTime + frameInterval;
+        double now = glfwGetTime();
+        bool wantFrame = redrawRequested || !eventDrivenLoop;
+        bool replayFrame = false;
+
+        if (replayRunning) {
+            replayFrame = replayUntilFrame(window);
+        } else if (!wantFrame) {
+            if (history.compressIdle()) {
+                glfwPollEvents(); // Encoded a cold clear; look at input before the next one
+            } else {
+                glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT_SEC); // Sleep until input, resize or timeout
+            }
+        } else if (now < nextFrameTime) {
+            glfwWaitEventsTimeout(nextFrameTime - now); // Keep handling input until the frame is due
+        } else {
+            glfwPollEvents(); // Process all pending events (input, window events)
+        }
+
+        pollScreenshot();
+        std::string journalError;
+        if (journal.pollError(journalError)) showStatusMessage("Autosave failed: " + journalError);
+        wantFrame = redrawRequested || !eventDrivenLoop;
+        now = glfwGetTime();
+        if (replayRunning ? !replayFrame : (!wantFrame || now < nextFrameTime)) continue;
+
+        redrawRequested = false;
+        lastFrameTime = now;
+        if (!replayRunning) glfwGetWindowSize(window, &windowWidth, &windowHeight); // Get current window size
         glViewport(0, 0, windowWidth, windowHeight); // Set the viewport to match window size
+        beginProfiledFrame();
         render(); // Call the rendering function to draw everything
-        glfwSwapBuffers(window); // Swap the front and back buffers to display the rendered frame
+        {
+            FramePhaseScope phase(PHASE_SWAP);
+            glfwSwapBuffers(window); // Swap the front and back buffers to display the rendered frame
+        }
+        double frameMs = (glfwGetTime() - now) * 1000.0;
+        if (frameProfiler.enabled()) frameProfiler.addFrame(frameMs);
+        if (replayRunning) replayFrameMs.push_back(frameMs);
+        InputEvent frame;
+        frame.type = INPUT_FRAME;
+        recordInput(frame);
     }
 
+    glDeleteBuffers(1, &strokeVbo);
+    glDeleteTextures(1, &canvasTexture);
+    glDeleteFramebuffers(1, &canvasFbo);
+    deleteAllCheckpoints();
+    glDeleteFramebuffers(1, &checkpointFbo);
+    deleteScreenshotResources();
+    deleteGpuTimers();
+    imageWriter.setOnFinished(nullptr);
+    imageWriter.finish(); // Writes the queued images while exportPool still exists
+    journal.close(); // Flushes the last records; the next start resumes from them
+    inputRecorder.close();
+    if (freehandSamplesIn > 0) {
+        std::cout << "Freehand strokes: stored " << freehandPointsStored << " points for " << freehandSamplesIn
+                  << " samples (" << (100 * (freehandSamplesIn - freehandPointsStored) / freehandSamplesIn)
+                  << "% saved)" << std::endl;
+    }
     glfwTerminate(); // Terminate GLFW when the loop ends (window closed)
     return 0;
 }
@@ -0,0 +1,81 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path, std::string& error) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    file->file_ = handle;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        error = "cannot read the size of " + path;
+        return nullptr;
+    }
+    file->size_ = static_cast<size_t>(size.QuadPart);
+    if (file->size_ == 0) return file; // Empty files cannot be mapped; data() stays null
+
+    file->mapping_ = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file->mapping_) {
+        file->data_ = static_cast<const uint8_t*>(MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!file->data_) {
+        error = "cannot map " + path;
+        return nullptr;
+    }
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path, std::string& error) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->fd_ = ::open(path.c_str(), O_RDONLY);
+    if (file->fd_ < 0) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(file->fd_, &info) != 0) {
+        error = "cannot read the size of " + path;
+        return nullptr;
+    }
+    file->size_ = static_cast<size_t>(info.st_size);
+    if (file->size_ == 0) return file; // Empty files cannot be mapped; data() stays null
+
+    void* data = mmap(nullptr, file->size_, PROT_READ, MAP_PRIVATE, file->fd_, 0);
+    if (data == MAP_FAILED) {
+        error = "cannot map " + path;
+        return nullptr;
+    }
+    file->data_ = static_cast<const uint8_t*>(data);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+    if (fd_ >= 0) close(fd_);
+}
+
+#endif
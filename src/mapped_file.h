@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// --- Memory-Mapped Files ---
+// A read-only view of a whole file. Pages are read from disk only when first touched, so
+// opening even a very large file costs next to nothing until its contents are used.
+
+class MappedFile {
+public:
+    // Returns null (and sets `error`) if the file cannot be opened or mapped
+    static std::shared_ptr<MappedFile> open(const std::string& path, std::string& error);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr; // HANDLEs
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
@@ -0,0 +1,260 @@
+#include "png_stream.h"
+#include "crc32.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+// --- Deflate tables (RFC 1951) ---
+
+const size_t WINDOW_SIZE = 32768; // Farthest a match may reach back
+const size_t WINDOW_MASK = WINDOW_SIZE - 1;
+const int HASH_BITS = 15;
+const int MIN_MATCH = 3, MAX_MATCH = 258;
+const int MAX_CHAIN = 16; // Candidates tried per position; drawings are mostly long runs
+const int MAX_INSERT = 32; // Positions inside longer matches are not hashed (zlib's fast mode)
+const size_t CHUNK_BYTES = 64 * 1024; // IDAT payload size
+
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                           257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                           8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                           7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void putBigEndian(uint8_t* out, uint32_t value) {
+    out[0] = value >> 24; out[1] = value >> 16; out[2] = value >> 8; out[3] = value;
+}
+
+PngStreamWriter::~PngStreamWriter() {
+    if (file_) std::fclose(file_);
+}
+
+bool PngStreamWriter::open(const std::string& path, int width, int height) {
+    if (file_ || width <= 0 || height <= 0) return false;
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) return false;
+    ok_ = true;
+    width_ = width;
+    height_ = height;
+    rowsWritten_ = 0;
+
+    size_t rowBytes = static_cast<size_t>(width) * 3;
+    previousRow_.assign(rowBytes, 0);
+    currentRow_.assign(rowBytes, 0);
+    for (auto& filtered : filtered_) filtered.assign(rowBytes + 1, 0);
+    window_.clear();
+    windowStart_ = pending_ = 0;
+    head_.assign(size_t(1) << HASH_BITS, -1);
+    prev_.assign(WINDOW_SIZE, -1);
+    adlerA_ = 1;
+    adlerB_ = 0;
+    bitBuffer_ = 0;
+    bitCount_ = 0;
+    chunk_.clear();
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    ok_ = std::fwrite(signature, 1, sizeof(signature), file_) == sizeof(signature);
+    uint8_t header[13];
+    putBigEndian(header, width);
+    putBigEndian(header + 4, height);
+    header[8] = 8; // Bits per channel
+    header[9] = 2; // RGB
+    header[10] = header[11] = header[12] = 0; // Deflate, adaptive filtering, no interlace
+    writeChunk("IHDR", header, sizeof(header));
+
+    chunk_.push_back(0x78); // zlib header: deflate, 32 KB window
+    chunk_.push_back(0x01);
+    putBits(0, 1); // The whole image is one fixed-Huffman block, closed by an empty final one
+    putBits(1, 2);
+    return ok_;
+}
+
+bool PngStreamWriter::writeRows(const uint8_t* rgba, int rows) {
+    if (!file_ || rowsWritten_ + rows > height_) return false;
+    const size_t rowBytes = currentRow_.size();
+    for (int r = 0; r < rows; ++r, rgba += static_cast<size_t>(width_) * 4) {
+        for (int x = 0; x < width_; ++x) {
+            currentRow_[x * 3] = rgba[x * 4];
+            currentRow_[x * 3 + 1] = rgba[x * 4 + 1];
+            currentRow_[x * 3 + 2] = rgba[x * 4 + 2];
+        }
+
+        // Filters 0 (None), 1 (Sub) and 2 (Up); the smallest sum of signed residuals usually
+        // compresses best
+        const uint8_t* row = currentRow_.data();
+        const uint8_t* above = previousRow_.data();
+        int best = 0;
+        long bestSum = -1;
+        for (int f = 0; f < 3; ++f) {
+            uint8_t* out = filtered_[f].data();
+            out[0] = static_cast<uint8_t>(f);
+            long sum = 0;
+            for (size_t i = 0; i < rowBytes; ++i) {
+                uint8_t predicted = f == 0 ? 0 : f == 1 ? (i >= 3 ? row[i - 3] : 0) : above[i];
+                out[i + 1] = static_cast<uint8_t>(row[i] - predicted);
+                sum += std::abs(static_cast<int8_t>(out[i + 1]));
+            }
+            if (bestSum < 0 || sum < bestSum) {
+                bestSum = sum;
+                best = f;
+            }
+        }
+        compress(filtered_[best].data(), rowBytes + 1, false);
+        previousRow_.swap(currentRow_);
+    }
+    rowsWritten_ += rows;
+    return ok_;
+}
+
+bool PngStreamWriter::close() {
+    if (!file_) return false;
+    compress(nullptr, 0, true);
+    putCode(0, 7); // End of block (256)
+    putBits(1, 1); // Final block, fixed Huffman, no symbols
+    putBits(1, 2);
+    putCode(0, 7);
+    if (bitCount_ > 0) putBits(0, 8 - bitCount_);
+    uint8_t adler[4];
+    putBigEndian(adler, (adlerB_ << 16) | adlerA_);
+    chunk_.insert(chunk_.end(), adler, adler + 4);
+    flushChunk(true);
+    writeChunk("IEND", nullptr, 0);
+
+    ok_ = std::fclose(file_) == 0 && ok_ && rowsWritten_ == height_;
+    file_ = nullptr;
+    window_ = std::vector<uint8_t>(); // Give the memory back
+    return ok_;
+}
+
+// LZ77 over the history window with hash chains. Without `flush`, the last MAX_MATCH bytes stay
+// pending so matches can use data from the next call.
+void PngStreamWriter::compress(const uint8_t* data, size_t size, bool flush) {
+    for (size_t done = 0; done < size;) { // Adler-32 of the uncompressed stream
+        size_t n = std::min<size_t>(size - done, 5552); // Largest run before the sums can overflow
+        for (size_t i = 0; i < n; ++i) {
+            adlerA_ += data[done + i];
+            adlerB_ += adlerA_;
+        }
+        adlerA_ %= 65521;
+        adlerB_ %= 65521;
+        done += n;
+    }
+    window_.insert(window_.end(), data, data + size);
+
+    const size_t end = window_.size();
+    const size_t limit = flush ? end : (end > MAX_MATCH ? end - MAX_MATCH : 0);
+    auto hashAt = [this](size_t i) {
+        return ((window_[i] << 10) ^ (window_[i + 1] << 5) ^ window_[i + 2]) & ((1u << HASH_BITS) - 1);
+    };
+    auto insert = [this](uint32_t hash, int64_t position) {
+        prev_[position & WINDOW_MASK] = head_[hash];
+        head_[hash] = position;
+    };
+
+    size_t i = pending_;
+    while (i < limit) {
+        int bestLength = 0;
+        int64_t bestDistance = 0;
+        if (i + MIN_MATCH <= end) {
+            uint32_t hash = hashAt(i);
+            int64_t position = static_cast<int64_t>(windowStart_ + i);
+            int maxLength = static_cast<int>(std::min<size_t>(MAX_MATCH, end - i));
+            const uint8_t* current = window_.data() + i;
+            int64_t candidate = head_[hash];
+            for (int chain = 0; chain < MAX_CHAIN && candidate >= 0 && candidate < position &&
+                                position - candidate <= static_cast<int64_t>(WINDOW_SIZE); ++chain) {
+                const uint8_t* earlier = window_.data() + (candidate - windowStart_);
+                int length = 0;
+                while (length < maxLength && earlier[length] == current[length]) ++length;
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = position - candidate;
+                    if (length == maxLength) break;
+                }
+                candidate = prev_[candidate & WINDOW_MASK];
+            }
+            insert(hash, position);
+        }
+
+        if (bestLength >= MIN_MATCH) {
+            emitMatch(bestLength, static_cast<int>(bestDistance));
+            if (bestLength <= MAX_INSERT) {
+                for (int k = 1; k < bestLength && i + k + MIN_MATCH <= end; ++k) {
+                    insert(hashAt(i + k), static_cast<int64_t>(windowStart_ + i + k));
+                }
+            }
+            i += bestLength;
+        } else {
+            emitLiteral(window_[i]);
+            ++i;
+        }
+    }
+    pending_ = i;
+
+    // Drop history that no match can reach any more
+    if (pending_ > 2 * WINDOW_SIZE) {
+        size_t drop = pending_ - WINDOW_SIZE;
+        window_.erase(window_.begin(), window_.begin() + drop);
+        windowStart_ += drop;
+        pending_ -= drop;
+    }
+    flushChunk(false);
+}
+
+// Fixed Huffman literal/length codes: 0-143 are 8 bits from 0x30, 144-255 are 9 bits from 0x190
+void PngStreamWriter::emitLiteral(uint8_t value) {
+    if (value < 144) putCode(0x30 + value, 8);
+    else putCode(0x190 + (value - 144), 9);
+}
+
+// Length codes 257-279 are 7 bits from 0, 280-287 are 8 bits from 0xC0; distances are 5 bits
+void PngStreamWriter::emitMatch(int length, int distance) {
+    int l = static_cast<int>(std::upper_bound(LENGTH_BASE, LENGTH_BASE + 29, length) - LENGTH_BASE) - 1;
+    int symbol = 257 + l;
+    if (symbol < 280) putCode(symbol - 256, 7);
+    else putCode(0xC0 + (symbol - 280), 8);
+    putBits(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+
+    int d = static_cast<int>(std::upper_bound(DISTANCE_BASE, DISTANCE_BASE + 30, distance) - DISTANCE_BASE) - 1;
+    putCode(d, 5);
+    putBits(distance - DISTANCE_BASE[d], DISTANCE_EXTRA[d]);
+}
+
+void PngStreamWriter::putBits(uint32_t bits, int count) {
+    bitBuffer_ |= bits << bitCount_;
+    bitCount_ += count;
+    while (bitCount_ >= 8) {
+        chunk_.push_back(static_cast<uint8_t>(bitBuffer_));
+        bitBuffer_ >>= 8;
+        bitCount_ -= 8;
+    }
+}
+
+void PngStreamWriter::putCode(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int b = 0; b < length; ++b) reversed |= ((code >> b) & 1) << (length - 1 - b);
+    putBits(reversed, length);
+}
+
+void PngStreamWriter::flushChunk(bool force) {
+    while (chunk_.size() >= CHUNK_BYTES || (force && !chunk_.empty())) {
+        size_t n = std::min(chunk_.size(), CHUNK_BYTES);
+        writeChunk("IDAT", chunk_.data(), n);
+        chunk_.erase(chunk_.begin(), chunk_.begin() + n);
+    }
+}
+
+void PngStreamWriter::writeChunk(const char type[4], const uint8_t* data, size_t size) {
+    uint8_t header[8];
+    putBigEndian(header, static_cast<uint32_t>(size));
+    std::memcpy(header + 4, type, 4);
+    uint32_t crc = crc32(crc32(0, header + 4, 4), data, size);
+    uint8_t trailer[4];
+    putBigEndian(trailer, crc);
+    ok_ = ok_ && std::fwrite(header, 1, 8, file_) == 8 && (size == 0 || std::fwrite(data, 1, size, file_) == size) &&
+          std::fwrite(trailer, 1, 4, file_) == 4;
+}
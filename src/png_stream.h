@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+// --- Streaming PNG Writer ---
+// Writes an RGB PNG a band of rows at a time, so an image never has to exist in memory as a
+// whole: memory use is bounded by the band plus the deflate window (32 KB of history).
+// Rows are filtered (None/Sub/Up, picked per row by the minimum-sum heuristic) and compressed
+// with a small LZ77 + fixed-Huffman deflate. Compressed output goes to the file in IDAT chunks
+// as soon as a chunk fills up.
+
+class PngStreamWriter {
+public:
+    PngStreamWriter() = default;
+    ~PngStreamWriter(); // Closes an unfinished file (the PNG is then incomplete)
+    PngStreamWriter(const PngStreamWriter&) = delete;
+    PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+
+    // Creates the file and writes the header
+    bool open(const std::string& path, int width, int height);
+    // Appends `rows` RGBA rows (top to bottom, `width` pixels each; alpha is dropped)
+    bool writeRows(const uint8_t* rgba, int rows);
+    // Finishes the stream. Fails if fewer rows than `height` were written or on any I/O error.
+    bool close();
+
+private:
+    // Deflate
+    void compress(const uint8_t* data, size_t size, bool flush);
+    void emitLiteral(uint8_t value);
+    void emitMatch(int length, int distance);
+    void putBits(uint32_t bits, int count); // LSB first
+    void putCode(uint32_t code, int length); // Huffman codes are stored MSB first
+
+    // Container
+    void flushChunk(bool force);
+    void writeChunk(const char type[4], const uint8_t* data, size_t size);
+
+    FILE* file_ = nullptr;
+    bool ok_ = false;
+    int width_ = 0, height_ = 0, rowsWritten_ = 0;
+
+    std::vector<uint8_t> previousRow_; // RGB of the row above (zeros for the first row)
+    std::vector<uint8_t> currentRow_;
+    std::vector<uint8_t> filtered_[3]; // Filter byte + row, for each candidate filter
+
+    std::vector<uint8_t> window_; // History (up to 32 KB) followed by data not yet compressed
+    size_t windowStart_ = 0; // Stream position of window_[0]
+    size_t pending_ = 0; // Index in window_ of the first byte not yet compressed
+    std::vector<int64_t> head_; // Hash of 3 bytes -> latest stream position
+    std::vector<int64_t> prev_; // Stream position & mask -> previous position with the same hash
+    uint32_t adlerA_ = 1, adlerB_ = 0;
+
+    uint32_t bitBuffer_ = 0;
+    int bitCount_ = 0;
+    std::vector<uint8_t> chunk_; // Compressed bytes waiting for the next IDAT
+};
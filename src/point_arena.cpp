@@ -0,0 +1,154 @@
+#include "point_arena.h"
+#include "document.h"
+
+PointArena::PointArena(uint32_t preallocatedBlocks) {
+    while (blocks_.size() < preallocatedBlocks) {
+        growSlab();
+    }
+}
+
+void PointArena::growSlab() {
+    slabs_.emplace_back(new Point[static_cast<size_t>(SLAB_BLOCKS) * BLOCK_POINTS]);
+    Point* slab = slabs_.back().get();
+    uint32_t firstNew = static_cast<uint32_t>(blocks_.size());
+
+    blocks_.reserve(blocks_.size() + SLAB_BLOCKS);
+    next_.reserve(next_.size() + SLAB_BLOCKS);
+    freeList_.reserve(blocks_.size() + SLAB_BLOCKS);
+    // Push in reverse so blocks are handed out in address order
+    for (uint32_t i = 0; i < SLAB_BLOCKS; ++i) {
+        blocks_.push_back(slab + static_cast<size_t>(i) * BLOCK_POINTS);
+        next_.push_back(NO_BLOCK);
+        external_.push_back(0);
+    }
+    for (uint32_t i = SLAB_BLOCKS; i > 0; --i) {
+        freeList_.push_back(firstNew + i - 1);
+    }
+}
+
+uint32_t PointArena::allocBlock() {
+    if (freeList_.empty()) {
+        growSlab();
+    }
+    uint32_t block = freeList_.back();
+    freeList_.pop_back();
+    next_[block] = NO_BLOCK;
+    return block;
+}
+
+void PointArena::append(FreehandRef& ref, const Point& point) {
+    uint32_t slot = ref.count % BLOCK_POINTS;
+    if (ref.count == 0) {
+        ref.firstBlock = ref.lastBlock = allocBlock();
+    } else if (slot == 0) { // Last block is full
+        uint32_t block = allocBlock();
+        next_[ref.lastBlock] = block;
+        ref.lastBlock = block;
+    }
+    blocks_[ref.lastBlock][slot] = point;
+    ref.count++;
+}
+
+void PointArena::release(FreehandRef& ref) {
+    uint32_t block = ref.count > 0 ? ref.firstBlock : NO_BLOCK;
+    while (block != NO_BLOCK) {
+        uint32_t next = next_[block];
+        next_[block] = NO_BLOCK;
+        if (!external_[block]) freeList_.push_back(block);
+        block = next;
+    }
+    ref = emptyRef();
+}
+
+void PointArena::truncate(FreehandRef& ref, uint32_t count) {
+    if (count >= ref.count) return;
+    if (count == 0) {
+        release(ref);
+        return;
+    }
+    uint32_t keepBlocks = blocksFor(count);
+    uint32_t block = ref.firstBlock;
+    for (uint32_t i = 1; i < keepBlocks; ++i) {
+        block = next_[block];
+    }
+    FreehandRef tail = {next_[block], ref.lastBlock, ref.count - count, 0};
+    next_[block] = NO_BLOCK;
+    if (tail.firstBlock != NO_BLOCK) {
+        release(tail);
+    }
+    ref.lastBlock = block;
+    ref.count = count;
+}
+
+void PointArena::overwrite(FreehandRef& ref, const Point* points, uint32_t count) {
+    uint32_t block = ref.firstBlock;
+    for (uint32_t written = 0; written < count; written += BLOCK_POINTS) {
+        uint32_t n = std::min(count - written, BLOCK_POINTS);
+        std::copy(points + written, points + written + n, blocks_[block]);
+        block = next_[block];
+    }
+    truncate(ref, count);
+}
+
+FreehandRef PointArena::adopt(const Point* points, uint32_t count) {
+    FreehandRef ref = emptyRef();
+    for (uint32_t done = 0; done < count; done += BLOCK_POINTS) {
+        uint32_t block = static_cast<uint32_t>(blocks_.size());
+        blocks_.push_back(const_cast<Point*>(points + done)); // Never written: external blocks are not recycled
+        next_.push_back(NO_BLOCK);
+        external_.push_back(1);
+        externalBlocks_.push_back({block, std::min(count - done, BLOCK_POINTS)});
+        if (done == 0) {
+            ref.firstBlock = block;
+        } else {
+            next_[ref.lastBlock] = block;
+        }
+        ref.lastBlock = block;
+    }
+    ref.count = count;
+    return ref;
+}
+
+void PointArena::internalize() {
+    size_t copied = 0;
+    while (copied < externalBlocks_.size()) {
+        slabs_.emplace_back(new Point[static_cast<size_t>(SLAB_BLOCKS) * BLOCK_POINTS]);
+        Point* slab = slabs_.back().get();
+        for (uint32_t i = 0; i < SLAB_BLOCKS; ++i) {
+            Point* storage = slab + static_cast<size_t>(i) * BLOCK_POINTS;
+            if (copied < externalBlocks_.size()) { // Same block index, so every chain stays valid
+                const ExternalBlock& external = externalBlocks_[copied++];
+                std::copy(blocks_[external.block], blocks_[external.block] + external.count, storage);
+                blocks_[external.block] = storage;
+                external_[external.block] = 0;
+            } else { // Rest of the last slab becomes free blocks
+                freeList_.reserve(blocks_.size() + 1);
+                freeList_.push_back(static_cast<uint32_t>(blocks_.size()));
+                blocks_.push_back(storage);
+                next_.push_back(NO_BLOCK);
+                external_.push_back(0);
+            }
+        }
+    }
+    freeList_.reserve(blocks_.size()); // The copied blocks can be released from now on
+    std::vector<ExternalBlock>().swap(externalBlocks_);
+    owners_.clear();
+}
+
+void PointArena::reset() {
+    std::vector<std::unique_ptr<Point[]>>().swap(slabs_);
+    std::vector<Point*>().swap(blocks_);
+    std::vector<uint32_t>().swap(next_);
+    std::vector<uint32_t>().swap(freeList_);
+    std::vector<uint8_t>().swap(external_);
+    std::vector<ExternalBlock>().swap(externalBlocks_);
+    owners_.clear();
+    growSlab();
+}
+
+size_t PointArena::bytesReserved() const {
+    return slabs_.size() * static_cast<size_t>(SLAB_BLOCKS) * BLOCK_POINTS * sizeof(Point)
+         + blocks_.capacity() * sizeof(Point*) + next_.capacity() * sizeof(uint32_t)
+         + freeList_.capacity() * sizeof(uint32_t) + external_.capacity()
+         + externalBlocks_.capacity() * sizeof(ExternalBlock);
+}
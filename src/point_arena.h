@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+struct Point;
+
+// A chain of arena blocks holding one freehand stroke's points
+struct FreehandRef {
+    uint32_t firstBlock;
+    uint32_t lastBlock; // Kept so appends are O(1)
+    uint32_t count; // Total points in the chain
+    uint32_t bezier; // Non-zero: the points are cubic Bezier control points (3n + 1), not samples
+};
+
+// --- Point Arena ---
+// Fixed-size blocks of points carved out of large slabs. A stroke's points live in a chain of
+// blocks, so appending a sample never reallocates or copies what was already recorded, and a
+// finished stroke is handed over by copying its 16-byte FreehandRef. Released chains go onto a
+// free list and are reused; the arena only touches the heap when the free list runs dry.
+class PointArena {
+public:
+    static constexpr uint32_t BLOCK_POINTS = 256; // Points per block (2 KB)
+    static constexpr uint32_t SLAB_BLOCKS = 64; // Blocks allocated together when the arena grows
+    static constexpr uint32_t NO_BLOCK = 0xFFFFFFFFu;
+
+    explicit PointArena(uint32_t preallocatedBlocks = SLAB_BLOCKS);
+    PointArena(const PointArena&) = delete;
+    PointArena& operator=(const PointArena&) = delete;
+
+    static FreehandRef emptyRef() { return {NO_BLOCK, NO_BLOCK, 0, 0}; }
+    static uint32_t blocksFor(uint32_t count) { return (count + BLOCK_POINTS - 1) / BLOCK_POINTS; }
+
+    void append(FreehandRef& ref, const Point& point);
+    void release(FreehandRef& ref); // Returns the chain's blocks to the free list
+    void truncate(FreehandRef& ref, uint32_t count); // Keeps the first `count` points
+    void overwrite(FreehandRef& ref, const Point* points, uint32_t count); // Replaces the contents; count <= ref.count
+
+    // External chains: points stored contiguously in memory the arena does not own (a mapped
+    // document file) are chained in place, one block per BLOCK_POINTS, without copying or
+    // touching them. `owner` keeps that memory alive until the arena is reset. External blocks
+    // are read-only and never go onto the free list; internalize() copies them into the arena.
+    void keepAlive(std::shared_ptr<const void> owner) { owners_.push_back(std::move(owner)); }
+    FreehandRef adopt(const Point* points, uint32_t count);
+    void internalize(); // Copies every external block into arena slabs and drops the owners
+    void reset(); // Forgets every chain and returns to the freshly constructed state
+
+    Point* blockData(uint32_t block) { return blocks_[block]; }
+    const Point* blockData(uint32_t block) const { return blocks_[block]; }
+    uint32_t nextBlock(uint32_t block) const { return next_[block]; }
+
+    // Calls fn(const Point* points, uint32_t n) for each contiguous run of the chain, in order
+    template <typename Fn>
+    void forEachSpan(const FreehandRef& ref, Fn&& fn) const {
+        uint32_t remaining = ref.count;
+        uint32_t block = ref.firstBlock;
+        while (remaining > 0) {
+            uint32_t n = std::min(remaining, BLOCK_POINTS);
+            fn(static_cast<const Point*>(blocks_[block]), n);
+            remaining -= n;
+            block = next_[block];
+        }
+    }
+
+    size_t totalBlocks() const { return blocks_.size(); }
+    size_t freeBlocks() const { return freeList_.size(); }
+    size_t bytesReserved() const; // Heap bytes owned by the arena
+
+private:
+    uint32_t allocBlock();
+    void growSlab();
+
+    std::vector<std::unique_ptr<Point[]>> slabs_;
+    std::vector<Point*> blocks_; // Block index -> storage inside a slab
+    std::vector<uint32_t> next_; // Block index -> next block in its chain (or NO_BLOCK)
+    std::vector<uint32_t> freeList_; // Capacity always covers every block, so pushes never allocate
+
+    struct ExternalBlock { uint32_t block, count; };
+    std::vector<uint8_t> external_; // Block index -> 1 if it points into external memory
+    std::vector<ExternalBlock> externalBlocks_; // External blocks and how many points each holds
+    std::vector<std::shared_ptr<const void>> owners_;
+};
@@ -0,0 +1,235 @@
+#include "raster.h"
+#include <cmath>
+#include <algorithm>
+
+// Helper: 0..1 color component to 0..255
+static inline uint8_t toByte(float value) {
+    return static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f);
+}
+
+// Inclusive pixel rectangle a primitive is clipped to
+struct TileBounds {
+    int x0, y0, x1, y1;
+};
+
+// Drawing logic: An antialiased capsule (every pixel within `radius` of the segment a-b, with a
+// one pixel coverage ramp at the edge). A dab is a capsule whose endpoints coincide.
+// Finds the run of pixels each row of the tile can touch and hands it to the SIMD row kernel.
+static void drawCapsule(RgbaImage& image, const TileBounds& clip, const Point& a, const Point& b, float radius,
+                        const uint8_t color[4], CapsuleRowFunc capsuleRow) {
+    const float reach = radius + 0.5f; // Coverage falls to zero half a pixel outside the edge
+    int y0 = std::max(clip.y0, static_cast<int>(std::floor(std::min(a.y, b.y) - reach)));
+    int y1 = std::min(clip.y1, static_cast<int>(std::ceil(std::max(a.y, b.y) + reach)));
+    if (y0 > y1) return;
+    if (std::max(a.x, b.x) + reach < clip.x0 || std::min(a.x, b.x) - reach > clip.x1 + 1) return;
+
+    float abx = b.x - a.x, aby = b.y - a.y;
+    float lengthSq = abx * abx + aby * aby;
+    CapsuleSpan span = {a.x, a.y, abx, aby, lengthSq > 0.0f ? 1.0f / lengthSq : 0.0f, reach,
+                        {color[0], color[1], color[2], color[3]}};
+
+    for (int y = y0; y <= y1; ++y) {
+        float py = y + 0.5f;
+        // Only the part of the segment within `reach` of this row can touch it
+        float t0 = 0.0f, t1 = 1.0f;
+        if (aby != 0.0f) {
+            float ta = (py - reach - a.y) / aby, tb = (py + reach - a.y) / aby;
+            t0 = std::max(0.0f, std::min(ta, tb));
+            t1 = std::min(1.0f, std::max(ta, tb));
+            if (t0 > t1) continue;
+        } else if (std::fabs(py - a.y) > reach) {
+            continue;
+        }
+        float xa = a.x + abx * t0, xb = a.x + abx * t1;
+        int x0 = std::max(clip.x0, static_cast<int>(std::floor(std::min(xa, xb) - reach)));
+        int x1 = std::min(clip.x1, static_cast<int>(std::ceil(std::max(xa, xb) + reach)));
+        if (x0 > x1) continue;
+        capsuleRow(image.row(y) + x0 * 4, x1 - x0 + 1, x0 + 0.5f, py, span);
+    }
+}
+
+// Drawing logic: A convex polygon without antialiasing; a pixel is filled when its center is inside
+static void fillConvexPolygon(RgbaImage& image, const TileBounds& clip, const Point* points, size_t count,
+                              const uint8_t color[4]) {
+    if (count < 3) return;
+    float minY = points[0].y, maxY = points[0].y;
+    for (size_t i = 1; i < count; ++i) {
+        minY = std::min(minY, points[i].y);
+        maxY = std::max(maxY, points[i].y);
+    }
+    int y0 = std::max(clip.y0, static_cast<int>(std::ceil(minY - 0.5f)));
+    int y1 = std::min(clip.y1, static_cast<int>(std::ceil(maxY - 0.5f)) - 1);
+
+    for (int y = y0; y <= y1; ++y) {
+        float py = y + 0.5f;
+        float left = 1e30f, right = -1e30f;
+        for (size_t i = 0; i < count; ++i) {
+            const Point& p = points[i];
+            const Point& q = points[(i + 1) % count];
+            if ((p.y <= py) == (q.y <= py)) continue; // Edge does not cross this row
+            float x = p.x + (py - p.y) / (q.y - p.y) * (q.x - p.x);
+            left = std::min(left, x);
+            right = std::max(right, x);
+        }
+        int x0 = std::max(clip.x0, static_cast<int>(std::ceil(left - 0.5f)));
+        int x1 = std::min(clip.x1, static_cast<int>(std::ceil(right - 0.5f)) - 1);
+        uint8_t* pixel = image.row(y) + x0 * 4;
+        for (int x = x0; x <= x1; ++x, pixel += 4) {
+            std::copy(color, color + 4, pixel);
+        }
+    }
+}
+
+void Rasterizer::render(const Document& document, const RasterOptions& options, RgbaImage& image) {
+    uint8_t clear[4] = {toByte(options.background[0]), toByte(options.background[1]), toByte(options.background[2]), 255};
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        std::copy(clear, clear + 4, image.pixels.data() + i);
+    }
+    drawStrokes(document, 0, document.strokes.size(), options, image);
+}
+
+void Rasterizer::renderRows(const Document& document, const RasterOptions& options, int width, int height,
+                            int firstRow, int rowCount, RgbaImage& band) {
+    RasterOptions rows = options;
+    float unitsPerRow = (options.top - options.bottom) / height;
+    rows.top = options.top - firstRow * unitsPerRow;
+    rows.bottom = options.top - (firstRow + rowCount) * unitsPerRow;
+    band.width = width;
+    band.height = rowCount;
+    band.pixels.resize(static_cast<size_t>(width) * rowCount * 4); // Keeps the buffer of the previous band
+    render(document, rows, band);
+}
+
+void Rasterizer::drawStrokes(const Document& document, size_t first, size_t last, const RasterOptions& options, RgbaImage& image) {
+    cullStrokes(document, first, std::min(last, document.strokes.size()), options, image);
+    prepare(document, options, image);
+    binStrokes(image);
+
+    CapsuleRowFunc capsuleRow = capsuleRowKernel(options.kernel);
+    auto drawOne = [this, capsuleRow, &image](size_t t) { drawTile(tiles_[t], capsuleRow, image); };
+    if (pool_) {
+        pool_->parallelFor(tiles_.size(), drawOne);
+    } else {
+        for (size_t t = 0; t < tiles_.size(); ++t) drawOne(t);
+    }
+}
+
+// Collects the strokes of [first, last) whose ink can reach the rendered region
+void Rasterizer::cullStrokes(const Document& document, size_t first, size_t last, const RasterOptions& options, const RgbaImage& image) {
+    visible_.clear();
+    if (document.index.size() != document.strokes.size()) { // No index to query: take them all
+        for (size_t s = first; s < last; ++s) visible_.push_back(static_cast<uint32_t>(s));
+        return;
+    }
+    float reach = document.index.maxStrokeSize() * options.sizeScale / 2.0f + 2.0f; // In image pixels
+    Bounds view = {std::min(options.left, options.right), std::min(options.bottom, options.top),
+                   std::max(options.left, options.right), std::max(options.bottom, options.top)};
+    view = view.padded(reach * (view.maxX - view.minX) / image.width, reach * (view.maxY - view.minY) / image.height);
+
+    // A view over most of the grid (full redraws, exports) would visit nearly every cell and
+    // sort out many duplicates, so testing each stroke's bounds in order is cheaper
+    float coveredX = std::max(0.0f, std::min(1.0f, view.maxX) - std::max(-1.0f, view.minX)) / 2.0f;
+    float coveredY = std::max(0.0f, std::min(1.0f, view.maxY) - std::max(-1.0f, view.minY)) / 2.0f;
+    if (coveredX * coveredY >= 0.5f) {
+        for (size_t s = first; s < last; ++s) {
+            if (document.index.bounds(static_cast<uint32_t>(s)).intersects(view)) visible_.push_back(static_cast<uint32_t>(s));
+        }
+        return;
+    }
+    document.index.queryRect(view, visible_);
+    visible_.erase(std::remove_if(visible_.begin(), visible_.end(),
+                                  [first, last](uint32_t s) { return s < first || s >= last; }),
+                   visible_.end());
+}
+
+// Tessellates the visible strokes into image pixels once, so tiles only have to draw them
+void Rasterizer::prepare(const Document& document, const RasterOptions& options, const RgbaImage& image) {
+    CurveScale scale;
+    scale.pixelsPerUnitX = image.width / (options.right - options.left);
+    scale.pixelsPerUnitY = image.height / (options.top - options.bottom);
+
+    vertices_.clear();
+    prepared_.clear();
+    for (uint32_t s : visible_) {
+        const Stroke& stroke = document.strokes[s];
+        const float* source = stroke.tool == TOOL_ERASER ? options.eraserColor : stroke.color;
+
+        PreparedStroke prepared;
+        prepared.firstVertex = static_cast<uint32_t>(vertices_.size());
+        prepared.fill = isFillTool(stroke.tool);
+        // GL draws smooth points and lines at least one pixel wide
+        float size = stroke.size * options.sizeScale;
+        prepared.dabRadius = prepared.fill ? 0.0f : std::max(0.5f, size / 2.0f);
+        prepared.lineRadius = prepared.fill ? 0.0f : std::max(0.5f, size / 4.0f);
+        prepared.color[0] = toByte(source[0]);
+        prepared.color[1] = toByte(source[1]);
+        prepared.color[2] = toByte(source[2]);
+        prepared.color[3] = 255;
+
+        // GL coordinates to image pixels (y flipped: row 0 is the top of the image)
+        const auto& vertices = tessellator_.tessellate(document, stroke, scale, options.sizeScale);
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            Point p((vertices[i].x - options.left) * scale.pixelsPerUnitX, (options.top - vertices[i].y) * scale.pixelsPerUnitY);
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+            vertices_.push_back(p);
+        }
+        prepared.vertexCount = static_cast<uint32_t>(vertices_.size()) - prepared.firstVertex;
+        if (prepared.vertexCount == 0) continue;
+
+        float reach = prepared.dabRadius + 1.0f;
+        prepared.x0 = std::max(0, static_cast<int>(std::floor(minX - reach)));
+        prepared.y0 = std::max(0, static_cast<int>(std::floor(minY - reach)));
+        prepared.x1 = std::min(image.width - 1, static_cast<int>(std::ceil(maxX + reach)));
+        prepared.y1 = std::min(image.height - 1, static_cast<int>(std::ceil(maxY + reach)));
+        if (prepared.x0 > prepared.x1 || prepared.y0 > prepared.y1) continue; // Entirely off the image
+        prepared_.push_back(prepared);
+    }
+}
+
+// Sorts prepared strokes into the tiles their bounds overlap, keeping stroke order in each tile
+void Rasterizer::binStrokes(const RgbaImage& image) {
+    int columns = (image.width + TILE_SIZE - 1) / TILE_SIZE;
+    int rows = (image.height + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_.resize(static_cast<size_t>(columns) * rows);
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            Tile& tile = tiles_[row * columns + column];
+            tile.x0 = column * TILE_SIZE;
+            tile.y0 = row * TILE_SIZE;
+            tile.x1 = std::min(image.width, tile.x0 + TILE_SIZE) - 1;
+            tile.y1 = std::min(image.height, tile.y0 + TILE_SIZE) - 1;
+            tile.strokes.clear();
+        }
+    }
+    for (uint32_t s = 0; s < prepared_.size(); ++s) {
+        const PreparedStroke& stroke = prepared_[s];
+        for (int row = stroke.y0 / TILE_SIZE; row <= stroke.y1 / TILE_SIZE; ++row) {
+            for (int column = stroke.x0 / TILE_SIZE; column <= stroke.x1 / TILE_SIZE; ++column) {
+                tiles_[row * columns + column].strokes.push_back(s);
+            }
+        }
+    }
+}
+
+// Same primitives and order as drawStrokeRange: every dab of a stroke, then its line strip
+void Rasterizer::drawTile(const Tile& tile, CapsuleRowFunc capsuleRow, RgbaImage& image) const {
+    TileBounds clip = {tile.x0, tile.y0, tile.x1, tile.y1};
+    for (uint32_t index : tile.strokes) {
+        const PreparedStroke& stroke = prepared_[index];
+        const Point* points = vertices_.data() + stroke.firstVertex;
+        if (stroke.fill) { // Triangle list
+            for (uint32_t i = 0; i + 3 <= stroke.vertexCount; i += 3) {
+                fillConvexPolygon(image, clip, points + i, 3, stroke.color);
+            }
+            continue;
+        }
+        for (uint32_t i = 0; i < stroke.vertexCount; ++i) {
+            drawCapsule(image, clip, points[i], points[i], stroke.dabRadius, stroke.color, capsuleRow);
+        }
+        for (uint32_t i = 1; i < stroke.vertexCount; ++i) {
+            drawCapsule(image, clip, points[i - 1], points[i], stroke.lineRadius, stroke.color, capsuleRow);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "document.h"
+#include "stroke_geometry.h"
+#include "raster_kernels.h"
+#include "thread_pool.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// --- CPU Rasterizer ---
+// Renders a document without a GL context (batch exports, benchmarks, machines without a GPU).
+// Strokes are drawn the way the GL renderer draws them, so the result is pixel-comparable with
+// the on-screen canvas: a smooth dab of `size` pixels at every vertex plus a smooth line of half
+// that width along the polyline, non-antialiased fills, and each primitive blended over the
+// image with its coverage as alpha (as GL_POINT_SMOOTH/GL_LINE_SMOOTH with GL_BLEND do).
+//
+// The image is split into TILE_SIZE tiles. Each stroke is binned into the tiles its bounding
+// box touches (in stroke order), and tiles are then drawn independently, in parallel when a
+// ThreadPool is given. Tiles never share pixels, so the result is identical on any thread count.
+// Strokes outside the rendered region are skipped using the document's spatial index.
+
+struct RgbaImage {
+    int width = 0, height = 0;
+    std::vector<uint8_t> pixels; // RGBA8, rows top to bottom
+
+    void resize(int w, int h) { width = w; height = h; pixels.assign(static_cast<size_t>(w) * h * 4, 0); }
+    uint8_t* row(int y) { return pixels.data() + static_cast<size_t>(y) * width * 4; }
+};
+
+struct RasterOptions {
+    // Region of GL space mapped onto the image (the whole window by default)
+    float left = -1.0f, bottom = -1.0f, right = 1.0f, top = 1.0f;
+    float sizeScale = 1.0f; // Image pixels per screen pixel; stroke sizes are multiplied by it
+    float background[3] = {1.0f, 1.0f, 1.0f};
+    float eraserColor[3] = {1.0f, 1.0f, 1.0f}; // The eraser paints this color
+    RasterKernel kernel = RasterKernel::Auto; // Force a specific SIMD kernel (for testing/benchmarks)
+};
+
+class Rasterizer {
+public:
+    static const int TILE_SIZE = 128; // Tile edge in pixels
+
+    explicit Rasterizer(ThreadPool* pool = nullptr) : pool_(pool) {}
+
+    // Clears the image to the background and draws every stroke
+    void render(const Document& document, const RasterOptions& options, RgbaImage& image);
+    // Renders rows [firstRow, firstRow + rowCount) of a `width` x `height` image of the region
+    // into `band`, so a huge image can be produced one horizontal band at a time
+    void renderRows(const Document& document, const RasterOptions& options, int width, int height,
+                    int firstRow, int rowCount, RgbaImage& band);
+    // Draws strokes [first, last) on top of what the image already holds
+    void drawStrokes(const Document& document, size_t first, size_t last, const RasterOptions& options, RgbaImage& image);
+
+private:
+    // A stroke tessellated into image pixels, ready to be drawn into any tile
+    struct PreparedStroke {
+        uint32_t firstVertex, vertexCount; // Range of `vertices_`
+        bool fill;
+        float dabRadius, lineRadius;
+        uint8_t color[4];
+        int x0, y0, x1, y1; // Pixel bounds it can touch (inclusive)
+    };
+    struct Tile {
+        int x0, y0, x1, y1; // Inclusive pixel bounds
+        std::vector<uint32_t> strokes; // Indices into `prepared_`, in drawing order
+    };
+
+    void cullStrokes(const Document& document, size_t first, size_t last, const RasterOptions& options, const RgbaImage& image);
+    void prepare(const Document& document, const RasterOptions& options, const RgbaImage& image);
+    void binStrokes(const RgbaImage& image);
+    void drawTile(const Tile& tile, CapsuleRowFunc capsuleRow, RgbaImage& image) const;
+
+    ThreadPool* pool_;
+    StrokeTessellator tessellator_;
+    std::vector<uint32_t> visible_; // Strokes that can touch the image, in drawing order
+    std::vector<Point> vertices_; // Every prepared stroke's vertices, in image pixels
+    std::vector<PreparedStroke> prepared_;
+    std::vector<Tile> tiles_;
+};
@@ -0,0 +1,156 @@
+#include "raster_kernels.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKETCHMATE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// All kernels quantize coverage to 0..256 and blend each channel as
+// (dst * (256 - a) + src * a + 128) >> 8, so their output matches bit for bit.
+
+static void capsuleRowScalar(uint8_t* pixels, int count, float px, float py, const CapsuleSpan& span) {
+    const float apy = py - span.ay;
+    for (int i = 0; i < count; ++i) {
+        float apx = px + static_cast<float>(i) - span.ax;
+        float t = std::max(0.0f, std::min(1.0f, (apx * span.abx + apy * span.aby) * span.invLengthSq));
+        float dx = apx - t * span.abx, dy = apy - t * span.aby;
+        float coverage = std::max(0.0f, std::min(1.0f, span.reach - std::sqrt(dx * dx + dy * dy)));
+        uint32_t a = static_cast<uint32_t>(coverage * 256.0f + 0.5f);
+        if (a == 0) continue;
+        uint8_t* pixel = pixels + i * 4;
+        for (int c = 0; c < 4; ++c) {
+            pixel[c] = static_cast<uint8_t>((pixel[c] * (256 - a) + span.color[c] * a + 128) >> 8);
+        }
+    }
+}
+
+#ifdef SKETCHMATE_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void capsuleRowSSE2(uint8_t* pixels, int count, float px, float py, const CapsuleSpan& span) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 ax = _mm_set1_ps(span.ax), abx = _mm_set1_ps(span.abx), aby = _mm_set1_ps(span.aby);
+    const __m128 invLengthSq = _mm_set1_ps(span.invLengthSq), reach = _mm_set1_ps(span.reach);
+    const __m128 apy = _mm_set1_ps(py - span.ay), vpx = _mm_set1_ps(px);
+    const __m128 apyAby = _mm_mul_ps(apy, aby);
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i byteMask = _mm_set1_epi32(0xFF), full = _mm_set1_epi32(256), half = _mm_set1_epi32(128);
+    __m128i color[4];
+    for (int c = 0; c < 4; ++c) color[c] = _mm_set1_epi32(span.color[c]);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 apx = _mm_sub_ps(_mm_add_ps(vpx, _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(i), lanes))), ax);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(apx, abx), apyAby), invLengthSq);
+        t = _mm_max_ps(zero, _mm_min_ps(one, t));
+        __m128 dx = _mm_sub_ps(apx, _mm_mul_ps(t, abx));
+        __m128 dy = _mm_sub_ps(apy, _mm_mul_ps(t, aby));
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 coverage = _mm_max_ps(zero, _mm_min_ps(one, _mm_sub_ps(reach, distance)));
+        __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(coverage, _mm_set1_ps(256.0f)), _mm_set1_ps(0.5f)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) == 0xFFFF) continue; // All outside
+
+        // One pixel per 32-bit lane; products stay below 2^16, so 16-bit multiplies are exact
+        __m128i inverse = _mm_sub_epi32(full, a);
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 4));
+        __m128i result = _mm_setzero_si128();
+        for (int c = 0; c < 4; ++c) {
+            __m128i channel = _mm_and_si128(_mm_srli_epi32(dst, 8 * c), byteMask);
+            __m128i blended = _mm_add_epi32(_mm_mullo_epi16(channel, inverse), _mm_mullo_epi16(color[c], a));
+            blended = _mm_srli_epi32(_mm_add_epi32(blended, half), 8);
+            result = _mm_or_si128(result, _mm_slli_epi32(blended, 8 * c));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i * 4), result);
+    }
+    capsuleRowScalar(pixels + i * 4, count - i, px + static_cast<float>(i), py, span);
+}
+
+__attribute__((target("avx2")))
+static void capsuleRowAVX2(uint8_t* pixels, int count, float px, float py, const CapsuleSpan& span) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 ax = _mm256_set1_ps(span.ax), abx = _mm256_set1_ps(span.abx), aby = _mm256_set1_ps(span.aby);
+    const __m256 invLengthSq = _mm256_set1_ps(span.invLengthSq), reach = _mm256_set1_ps(span.reach);
+    const __m256 apy = _mm256_set1_ps(py - span.ay), vpx = _mm256_set1_ps(px);
+    const __m256 apyAby = _mm256_mul_ps(apy, aby);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF), full = _mm256_set1_epi32(256), half = _mm256_set1_epi32(128);
+    __m256i color[4];
+    for (int c = 0; c < 4; ++c) color[c] = _mm256_set1_epi32(span.color[c]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 apx = _mm256_sub_ps(_mm256_add_ps(vpx, _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i), lanes))), ax);
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(apx, abx), apyAby), invLengthSq);
+        t = _mm256_max_ps(zero, _mm256_min_ps(one, t));
+        __m256 dx = _mm256_sub_ps(apx, _mm256_mul_ps(t, abx));
+        __m256 dy = _mm256_sub_ps(apy, _mm256_mul_ps(t, aby));
+        __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 coverage = _mm256_max_ps(zero, _mm256_min_ps(one, _mm256_sub_ps(reach, distance)));
+        __m256i a = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(coverage, _mm256_set1_ps(256.0f)), _mm256_set1_ps(0.5f)));
+        if (_mm256_testz_si256(a, a)) continue; // All outside
+
+        __m256i inverse = _mm256_sub_epi32(full, a);
+        __m256i dst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i * 4));
+        __m256i result = _mm256_setzero_si256();
+        for (int c = 0; c < 4; ++c) {
+            __m256i channel = _mm256_and_si256(_mm256_srli_epi32(dst, 8 * c), byteMask);
+            __m256i blended = _mm256_add_epi32(_mm256_mullo_epi16(channel, inverse), _mm256_mullo_epi16(color[c], a));
+            blended = _mm256_srli_epi32(_mm256_add_epi32(blended, half), 8);
+            result = _mm256_or_si256(result, _mm256_slli_epi32(blended, 8 * c));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i * 4), result);
+    }
+    capsuleRowScalar(pixels + i * 4, count - i, px + static_cast<float>(i), py, span);
+}
+
+#endif // SKETCHMATE_X86_KERNELS
+
+// Helper: Whether the CPU can run a kernel
+static bool kernelSupported(RasterKernel kernel) {
+    switch (kernel) {
+        case RasterKernel::Scalar:
+            return true;
+#ifdef SKETCHMATE_X86_KERNELS
+        case RasterKernel::SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case RasterKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+RasterKernel activeRasterKernel() {
+    static const RasterKernel best = kernelSupported(RasterKernel::AVX2) ? RasterKernel::AVX2
+                                   : kernelSupported(RasterKernel::SSE2) ? RasterKernel::SSE2
+                                   : RasterKernel::Scalar;
+    return best;
+}
+
+CapsuleRowFunc capsuleRowKernel(RasterKernel which) {
+    if (which == RasterKernel::Auto || !kernelSupported(which)) {
+        which = (which == RasterKernel::Auto) ? activeRasterKernel() : RasterKernel::Scalar;
+    }
+    switch (which) {
+#ifdef SKETCHMATE_X86_KERNELS
+        case RasterKernel::AVX2: return capsuleRowAVX2;
+        case RasterKernel::SSE2: return capsuleRowSSE2;
+#endif
+        default: return capsuleRowScalar;
+    }
+}
+
+const char* rasterKernelName(RasterKernel kernel) {
+    switch (kernel) {
+        case RasterKernel::Auto: return rasterKernelName(activeRasterKernel());
+        case RasterKernel::Scalar: return "scalar";
+        case RasterKernel::SSE2: return "sse2";
+        case RasterKernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
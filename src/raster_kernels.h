@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+// --- Rasterizer Kernels ---
+// The inner loop of the CPU rasterizer: antialiased coverage of a capsule (all points within a
+// radius of a segment) for a run of pixels on one row, blended into RGBA8 pixels. Scalar, SSE2
+// (4 pixels per step) and AVX2 (8 pixels per step) versions produce identical pixels; the fastest
+// one the CPU supports is picked at runtime.
+
+struct CapsuleSpan {
+    float ax, ay; // Segment start, in image pixels
+    float abx, aby; // Segment direction (end - start)
+    float invLengthSq; // 1 / |ab|^2, or 0 for a dab
+    float reach; // Radius + half a pixel: coverage is clamp(reach - distance, 0, 1)
+    uint8_t color[4]; // RGBA8 blended over the pixels with the coverage as alpha
+};
+
+enum class RasterKernel {
+    Auto,   // Best supported by this CPU
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Blends `count` pixels of one row starting at pixel center (px, py)
+typedef void (*CapsuleRowFunc)(uint8_t* pixels, int count, float px, float py, const CapsuleSpan& span);
+
+// Returns the capsule kernel to use; `which` falls back to Scalar if the CPU lacks it
+CapsuleRowFunc capsuleRowKernel(RasterKernel which = RasterKernel::Auto);
+RasterKernel activeRasterKernel(); // What Auto resolves to on this CPU
+const char* rasterKernelName(RasterKernel kernel);
@@ -0,0 +1,78 @@
+#include "simplify.h"
+#include <cmath>
+#include <algorithm>
+
+float maxDabGapPx(float sizePx, float tolerancePx) {
+    float r = sizePx / 2.0f;
+    if (tolerancePx >= r) return 2.0f * r;
+    float d = r - tolerancePx; // Distance from a dab center to the chord between two dabs
+    return std::max(1.0f, 2.0f * std::sqrt(r * r - d * d));
+}
+
+// Helper: Squared pixel distance from p to the segment a-b
+static float segmentDistanceSq(const Point& p, const Point& a, const Point& b, float sx, float sy) {
+    float abx = (b.x - a.x) * sx, aby = (b.y - a.y) * sy;
+    float apx = (p.x - a.x) * sx, apy = (p.y - a.y) * sy;
+    float lengthSq = abx * abx + aby * aby;
+    float t = lengthSq > 0.0f ? std::max(0.0f, std::min(1.0f, (apx * abx + apy * aby) / lengthSq)) : 0.0f;
+    float dx = apx - t * abx, dy = apy - t * aby;
+    return dx * dx + dy * dy;
+}
+
+uint32_t StrokeSimplifier::simplify(PointArena& arena, FreehandRef& stroke, float sizePx, const SimplifySettings& settings) {
+    uint32_t count = stroke.count;
+    if (count < 3) return 0;
+
+    points_.clear();
+    arena.forEachSpan(stroke, [this](const Point* points, uint32_t n) {
+        points_.insert(points_.end(), points, points + n);
+    });
+    keep_.assign(count, 0);
+    keep_[0] = keep_[count - 1] = 1;
+
+    const float sx = settings.pixelsPerUnitX, sy = settings.pixelsPerUnitY;
+    const float toleranceSq = settings.tolerancePx * settings.tolerancePx;
+    const float maxGap = maxDabGapPx(sizePx, settings.tolerancePx);
+    const float maxGapSq = maxGap * maxGap;
+
+    // Iterative RDP: split a span at its farthest point while it deviates too much, or at
+    // its midpoint while its endpoints are too far apart for the dabs to overlap.
+    stack_.clear();
+    stack_.push_back(0);
+    stack_.push_back(count - 1);
+    while (!stack_.empty()) {
+        uint32_t last = stack_.back(); stack_.pop_back();
+        uint32_t first = stack_.back(); stack_.pop_back();
+        if (last - first < 2) continue;
+
+        const Point& a = points_[first];
+        const Point& b = points_[last];
+        float farthestSq = -1.0f;
+        uint32_t split = first + 1;
+        for (uint32_t i = first + 1; i < last; ++i) {
+            float distanceSq = segmentDistanceSq(points_[i], a, b, sx, sy);
+            if (distanceSq > farthestSq) {
+                farthestSq = distanceSq;
+                split = i;
+            }
+        }
+        if (farthestSq <= toleranceSq) {
+            float dx = (b.x - a.x) * sx, dy = (b.y - a.y) * sy;
+            if (dx * dx + dy * dy <= maxGapSq) continue; // Interior points can all go
+            split = first + (last - first) / 2;
+        }
+        keep_[split] = 1;
+        stack_.push_back(first);
+        stack_.push_back(split);
+        stack_.push_back(split);
+        stack_.push_back(last);
+    }
+
+    // Compact the kept points, then write them back over the chain (releasing unused blocks)
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (keep_[i]) points_[kept++] = points_[i];
+    }
+    arena.overwrite(stroke, points_.data(), kept);
+    return count - kept;
+}
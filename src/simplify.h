@@ -0,0 +1,32 @@
+#pragma once
+#include "document.h"
+#include <vector>
+#include <cstdint>
+
+// --- Stroke Simplification ---
+// Ramer-Douglas-Peucker on a freehand stroke at commit time. Points that lie within
+// `tolerancePx` of the simplified polyline are dropped. Because brushes are drawn as a dab at
+// every sample, kept points are also never further apart than `maxGapPx` (unless the raw samples
+// already were), so the dabs still overlap into a solid line and the result looks the same.
+
+struct SimplifySettings {
+    float tolerancePx = 0.5f; // Maximum deviation from the raw stroke, in canvas pixels
+    float pixelsPerUnitX = 1.0f; // Canvas pixels per GL unit (half the framebuffer size)
+    float pixelsPerUnitY = 1.0f;
+};
+
+// Largest dab spacing at which a brush of `sizePx` still deviates by at most `tolerancePx`
+// from a solid line (the sagitta of the overlapping dabs).
+float maxDabGapPx(float sizePx, float tolerancePx);
+
+class StrokeSimplifier {
+public:
+    // Simplifies the chain in place and returns how many points were removed.
+    // Scratch buffers are reused between calls, so steady-state simplification never allocates.
+    uint32_t simplify(PointArena& arena, FreehandRef& stroke, float sizePx, const SimplifySettings& settings);
+
+private:
+    std::vector<Point> points_; // Copy of the chain for random access
+    std::vector<uint8_t> keep_;
+    std::vector<uint32_t> stack_; // Pending [first, last] index pairs
+};
@@ -0,0 +1,74 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+// Helper: Grid cells a box overlaps, clamped to the grid. Clamped before the cast, which is
+// undefined for values out of int range (e.g. the +-1e30 box of a stroke without points) or NaN.
+SpatialIndex::CellRange SpatialIndex::cellRange(const Bounds& bounds) {
+    auto toCell = [](float v) {
+        float cell = std::floor((v + 1.0f) * 0.5f * GRID_CELLS);
+        if (!(cell > 0.0f)) return 0; // Also NaN
+        return static_cast<int>(std::min(cell, static_cast<float>(GRID_CELLS - 1)));
+    };
+    return {toCell(bounds.minX), toCell(bounds.minY), toCell(bounds.maxX), toCell(bounds.maxY)};
+}
+
+void SpatialIndex::insert(uint32_t stroke, const Bounds& bounds, float strokeSize) {
+    if (cells_.empty()) cells_.resize(GRID_CELLS * GRID_CELLS);
+    bounds_.push_back(bounds);
+    maxStrokeSize_ = std::max(maxStrokeSize_, strokeSize);
+    CellRange range = cellRange(bounds);
+    for (int y = range.y0; y <= range.y1; ++y) {
+        for (int x = range.x0; x <= range.x1; ++x) {
+            cell(x, y).push_back(stroke);
+        }
+    }
+}
+
+void SpatialIndex::removeLast() {
+    if (bounds_.empty()) return;
+    CellRange range = cellRange(bounds_.back());
+    for (int y = range.y0; y <= range.y1; ++y) {
+        for (int x = range.x0; x <= range.x1; ++x) {
+            cell(x, y).pop_back(); // The last stroke is the last entry of every cell it is in
+        }
+    }
+    bounds_.pop_back();
+}
+
+void SpatialIndex::clear() {
+    bounds_.clear();
+    maxStrokeSize_ = 0.0f;
+    for (auto& list : cells_) list.clear();
+}
+
+void SpatialIndex::queryPoint(float x, float y, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (cells_.empty()) return;
+    CellRange range = cellRange({x, y, x, y});
+    for (uint32_t stroke : cell(range.x0, range.y0)) {
+        if (bounds_[stroke].contains(x, y)) out.push_back(stroke);
+    }
+}
+
+void SpatialIndex::queryRect(const Bounds& box, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (cells_.empty()) return;
+    CellRange range = cellRange(box);
+    for (int y = range.y0; y <= range.y1; ++y) {
+        for (int x = range.x0; x <= range.x1; ++x) {
+            for (uint32_t stroke : cell(x, y)) {
+                if (bounds_[stroke].intersects(box)) out.push_back(stroke);
+            }
+        }
+    }
+    // A stroke spanning several cells was found once per cell
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+size_t SpatialIndex::bytes() const {
+    size_t total = bounds_.capacity() * sizeof(Bounds) + cells_.capacity() * sizeof(std::vector<uint32_t>);
+    for (const auto& list : cells_) total += list.capacity() * sizeof(uint32_t);
+    return total;
+}
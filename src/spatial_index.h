@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Axis-aligned box in GL coordinates
+struct Bounds {
+    float minX, minY, maxX, maxY;
+
+    bool contains(float x, float y) const { return x >= minX && x <= maxX && y >= minY && y <= maxY; }
+    bool intersects(const Bounds& other) const {
+        return minX <= other.maxX && maxX >= other.minX && minY <= other.maxY && maxY >= other.minY;
+    }
+    Bounds padded(float dx, float dy) const { return {minX - dx, minY - dy, maxX + dx, maxY + dy}; }
+};
+
+// --- Spatial Index ---
+// Each committed stroke's geometric bounds (without its thickness) in a uniform grid over the
+// window's GL square. Strokes are only ever added or removed at the end of the document, so every
+// cell's list stays sorted by stroke index and both operations are O(cells covered). Queries only
+// visit the cells they overlap and return candidates in drawing order.
+
+class SpatialIndex {
+public:
+    static const int GRID_CELLS = 32; // Cells per axis over [-1, 1]
+
+    void insert(uint32_t stroke, const Bounds& bounds, float strokeSize); // `stroke` must equal size()
+    void removeLast();
+    void clear();
+
+    size_t size() const { return bounds_.size(); }
+    const Bounds& bounds(uint32_t stroke) const { return bounds_[stroke]; }
+    // Largest stroke size (in screen pixels) ever inserted: how far ink can reach past the bounds
+    float maxStrokeSize() const { return maxStrokeSize_; }
+
+    // Strokes whose bounds contain the point / intersect the box, in ascending order
+    void queryPoint(float x, float y, std::vector<uint32_t>& out) const;
+    void queryRect(const Bounds& box, std::vector<uint32_t>& out) const;
+
+    size_t bytes() const; // Heap memory held by the index
+
+private:
+    struct CellRange { int x0, y0, x1, y1; };
+    static CellRange cellRange(const Bounds& bounds);
+    std::vector<uint32_t>& cell(int x, int y) { return cells_[y * GRID_CELLS + x]; }
+    const std::vector<uint32_t>& cell(int x, int y) const { return cells_[y * GRID_CELLS + x]; }
+
+    std::vector<Bounds> bounds_; // Indexed by stroke
+    std::vector<std::vector<uint32_t>> cells_; // Allocated on first insert
+    float maxStrokeSize_ = 0.0f;
+};
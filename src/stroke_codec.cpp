@@ -0,0 +1,112 @@
+#include "stroke_codec.h"
+#include "varint.h"
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const int32_t MAX_GRID_COORD = 1 << 28; // GL +-8192: keeps every prediction and residual within int32
+
+// Running state on both sides: the last position and its velocity (zero after the first point)
+struct Predictor {
+    int32_t x = 0, y = 0, vx = 0, vy = 0;
+    bool started = false;
+
+    void advance(int32_t nextX, int32_t nextY) {
+        vx = started ? nextX - x : 0;
+        vy = started ? nextY - y : 0;
+        x = nextX;
+        y = nextY;
+        started = true;
+    }
+};
+
+// Helper: GL coordinate -> grid step (non-finite values map to 0)
+static int32_t quantize(float v) {
+    double scaled = static_cast<double>(v) * PACKED_POINT_SCALE;
+    if (!(scaled > -MAX_GRID_COORD)) return scaled < 0.0 ? -MAX_GRID_COORD : 0;
+    if (scaled > MAX_GRID_COORD) return MAX_GRID_COORD;
+    return static_cast<int32_t>(std::lround(scaled));
+}
+
+void encodePoints(const PointArena& arena, const FreehandRef& ref, std::vector<uint8_t>& out) {
+    Predictor predictor;
+    arena.forEachSpan(ref, [&out, &predictor](const Point* points, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+            int32_t qx = quantize(points[i].x), qy = quantize(points[i].y);
+            putVarint(out, qx - (predictor.x + predictor.vx));
+            putVarint(out, qy - (predictor.y + predictor.vy));
+            predictor.advance(qx, qy);
+        }
+    });
+}
+
+// Decodes `count` points continuing from the predictor's state
+static bool decodeRun(const uint8_t*& data, const uint8_t* end, uint32_t count, Point* out, Predictor& predictor) {
+    const float step = 1.0f / PACKED_POINT_SCALE;
+    uint32_t i = 0;
+    while (i < count) {
+#ifdef __SSE2__
+        // Fast path: the next 16 bytes are all one-byte varints, i.e. 8 whole points
+        if (predictor.started && count - i >= 8 && end - data >= 16 &&
+            _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))) == 0) {
+            int32_t x = predictor.x, y = predictor.y, vx = predictor.vx, vy = predictor.vy;
+            for (int k = 0; k < 8; ++k) {
+                int32_t zx = data[2 * k], zy = data[2 * k + 1];
+                vx += (zx >> 1) ^ -(zx & 1);
+                vy += (zy >> 1) ^ -(zy & 1);
+                x += vx;
+                y += vy;
+                out[i + k] = Point(x * step, y * step);
+            }
+            predictor.x = x; predictor.y = y; predictor.vx = vx; predictor.vy = vy;
+            data += 16;
+            i += 8;
+            continue;
+        }
+#endif
+        int32_t rx, ry;
+        if (!getVarint(data, end, rx) || !getVarint(data, end, ry)) return false;
+        int32_t x = predictor.x + predictor.vx + rx, y = predictor.y + predictor.vy + ry;
+        predictor.advance(x, y);
+        out[i++] = Point(x * step, y * step);
+    }
+    return true;
+}
+
+bool decodePoints(const uint8_t*& data, const uint8_t* end, uint32_t count, Point* out) {
+    Predictor predictor;
+    return decodeRun(data, end, count, out, predictor);
+}
+
+bool decodePoints(const uint8_t*& data, const uint8_t* end, uint32_t count, PointArena& arena, FreehandRef& ref) {
+    ref = PointArena::emptyRef();
+    Point batch[PointArena::BLOCK_POINTS];
+    Predictor predictor;
+    for (uint32_t done = 0; done < count;) {
+        uint32_t n = std::min(count - done, PointArena::BLOCK_POINTS);
+        if (!decodeRun(data, end, n, batch, predictor)) {
+            arena.release(ref);
+            return false;
+        }
+        for (uint32_t i = 0; i < n; ++i) arena.append(ref, batch[i]);
+        done += n;
+    }
+    return true;
+}
+
+bool validatePoints(const uint8_t* data, const uint8_t* end, uint32_t count) {
+    uint64_t varints = 0;
+    int length = 0;
+    for (const uint8_t* p = data; p != end; ++p) {
+        if (*p & 0x80) {
+            if (++length == 5) return false;
+        } else {
+            ++varints;
+            length = 0;
+        }
+    }
+    return length == 0 && varints == 2ull * count;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "document.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// --- Stroke Codec ---
+// Compact encoding for freehand points. Coordinates are quantized to the PackedPoint grid
+// (1/32767 of the GL half-width, well under a hundredth of a pixel; the GPU copy uses the same
+// grid), but to 32-bit integers, so Bezier control points just outside the canvas survive.
+// Each point is stored as its difference from a constant-velocity prediction (the previous
+// point plus the previous step), zigzag-mapped to an unsigned value and written as a LEB128
+// varint: x then y. Along a smooth stroke the step barely changes, so most coordinates take
+// one or two bytes instead of four.
+//
+// Decoding checks 16 bytes at a time for continuation bits; a run of one-byte varints (slow,
+// detailed drawing) is then decoded eight points at a time without per-byte branches.
+
+// Appends a chain's points to `out`
+void encodePoints(const PointArena& arena, const FreehandRef& ref, std::vector<uint8_t>& out);
+
+// Decodes `count` points from [data, end) into a new chain of `arena`, advancing `data`.
+// Returns false (and leaves `ref` empty) if the data ends early or is malformed.
+bool decodePoints(const uint8_t*& data, const uint8_t* end, uint32_t count, PointArena& arena, FreehandRef& ref);
+
+// Decodes into plain memory instead; `out` must hold `count` points
+bool decodePoints(const uint8_t*& data, const uint8_t* end, uint32_t count, Point* out);
+
+// True if [data, end) holds exactly `count` encoded points, i.e. decoding it cannot fail
+bool validatePoints(const uint8_t* data, const uint8_t* end, uint32_t count);
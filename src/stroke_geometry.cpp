@@ -0,0 +1,82 @@
+#define _USE_MATH_DEFINES // Define this before including cmath to get M_PI
+#include "stroke_geometry.h"
+#include "simplify.h"
+#include <cmath>
+
+// Analytic shapes are tessellated exactly as they used to be sampled at commit time:
+// rectangle outlines as a closed 5-point loop, circle outlines every 5 degrees and disc fills
+// every 10 degrees (matching drawCircle/drawRect).
+// Fills are split into triangles so any number of them can share one GL_TRIANGLES draw.
+const std::vector<Point>& StrokeTessellator::tessellate(const Document& document, const Stroke& stroke, const CurveScale& scale,
+                                                        float sizeScale) {
+    vertices_.clear();
+    switch (stroke.tool) {
+        case TOOL_BRUSH:
+        case TOOL_ERASER:
+            if (stroke.freehand.bezier) {
+                // Segments stay short enough for the dabs to overlap into a solid line
+                return flattener_.flatten(document.arena, stroke.freehand, CURVE_FLATNESS_PX,
+                                          maxDabGapPx(stroke.size * sizeScale, DAB_TOLERANCE_PX), scale);
+            }
+            forEachStrokeSpan(document, stroke, [this](const Point* points, uint32_t n) {
+                vertices_.insert(vertices_.end(), points, points + n);
+            });
+            break;
+        case TOOL_RECTANGLE: {
+            const Point& a = stroke.rect.start;
+            const Point& b = stroke.rect.end;
+            vertices_.push_back(Point(a.x, a.y));
+            vertices_.push_back(Point(b.x, a.y));
+            vertices_.push_back(Point(b.x, b.y));
+            vertices_.push_back(Point(a.x, b.y));
+            vertices_.push_back(Point(a.x, a.y)); // Close the loop
+            break;
+        }
+        case TOOL_CIRCLE:
+            for (int i = 0; i <= 360; i += 5) {
+                float angle = i * M_PI / 180.0f;
+                vertices_.push_back(Point(stroke.circle.center.x + stroke.circle.radius * std::cos(angle),
+                                          stroke.circle.center.y + stroke.circle.radius * std::sin(angle)));
+            }
+            break;
+        case TOOL_LINE:
+            vertices_.push_back(stroke.line.start);
+            vertices_.push_back(stroke.line.end);
+            break;
+        case TOOL_FILL:
+            if (stroke.fill.radius > 0) { // Fan of triangles from the center
+                Point rim = Point(stroke.fill.center.x + stroke.fill.radius, stroke.fill.center.y);
+                for (int i = 10; i <= 360; i += 10) {
+                    float angle = i * M_PI / 180.0f;
+                    Point next(stroke.fill.center.x + stroke.fill.radius * std::cos(angle),
+                               stroke.fill.center.y + stroke.fill.radius * std::sin(angle));
+                    vertices_.push_back(stroke.fill.center);
+                    vertices_.push_back(rim);
+                    vertices_.push_back(next);
+                    rim = next;
+                }
+            } else {
+                addQuad(stroke.fill.min, stroke.fill.max);
+            }
+            break;
+        case TOOL_MASK_FILL: {
+            const MaskShape& mask = stroke.mask;
+            for (const auto& run : document.masks.runs(mask.mask)) {
+                addQuad(Point(mask.origin.x + run.x0 * mask.pixelWidth, mask.origin.y + run.y * mask.pixelHeight),
+                        Point(mask.origin.x + run.x1 * mask.pixelWidth, mask.origin.y + (run.y + 1) * mask.pixelHeight));
+            }
+            break;
+        }
+    }
+    return vertices_;
+}
+
+// Helper: Two triangles covering the axis-aligned rectangle min-max
+void StrokeTessellator::addQuad(const Point& min, const Point& max) {
+    vertices_.push_back(Point(min.x, min.y));
+    vertices_.push_back(Point(max.x, min.y));
+    vertices_.push_back(Point(max.x, max.y));
+    vertices_.push_back(Point(min.x, min.y));
+    vertices_.push_back(Point(max.x, max.y));
+    vertices_.push_back(Point(min.x, max.y));
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "document.h"
+#include "curves.h"
+#include <vector>
+
+// --- Stroke Geometry ---
+// Turns a stroke into the vertices it is drawn with, shared by the GL renderer and the CPU
+// rasterizer so both draw exactly the same shapes. Outlined strokes (freehand, rectangle,
+// circle, line) become a polyline that is drawn as a dab of `size` pixels at every vertex plus
+// a line of half that width along it. Fills (discs, rectangles and flood-fill masks) become a
+// triangle list.
+
+const float CURVE_FLATNESS_PX = 0.25f; // Max distance of a flattened curve stroke from the curve
+const float DAB_TOLERANCE_PX = 0.5f; // Max dent between overlapping dabs (see maxDabGapPx)
+
+class StrokeTessellator {
+public:
+    // Vertices in GL coordinates. `scale` is the output resolution curve strokes are flattened for,
+    // and `sizeScale` how much stroke sizes (in screen pixels) are magnified at that resolution.
+    const std::vector<Point>& tessellate(const Document& document, const Stroke& stroke, const CurveScale& scale,
+                                         float sizeScale = 1.0f);
+
+private:
+    void addQuad(const Point& min, const Point& max);
+
+    CurveFlattener flattener_;
+    std::vector<Point> vertices_;
+};
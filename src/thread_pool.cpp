@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threadCount; ++i) {
+        queues_.emplace_back(new Queue());
+    }
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) return;
+    if (workers_.empty()) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+
+    // Published before any item is queued: a worker still stealing from the previous loop
+    // may pick up the new items as soon as they appear
+    body_ = &body;
+    remaining_ = count;
+
+    // Contiguous chunks per queue keep neighbouring items (adjacent tiles) on one thread
+    size_t threads = queues_.size();
+    for (size_t q = 0; q < threads; ++q) {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        for (size_t i = count * q / threads; i < count * (q + 1) / threads; ++i) {
+            queues_[q]->items.push_back(i);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_++;
+    }
+    wake_.notify_all();
+
+    while (runOne(0)) {}
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_ == 0; });
+    body_ = nullptr;
+}
+
+bool ThreadPool::runOne(unsigned self) {
+    size_t item = 0;
+    bool found = false;
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.items.empty()) {
+            item = own.items.back(); // Own work is taken from the back...
+            own.items.pop_back();
+            found = true;
+        }
+    }
+    for (size_t offset = 1; !found && offset < queues_.size(); ++offset) {
+        Queue& victim = *queues_[(self + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.items.empty()) {
+            item = victim.items.front(); // ...and stolen work from the front
+            victim.items.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    (*body_)(item);
+    if (remaining_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned self) {
+    size_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seenGeneration; });
+            if (stopping_) return;
+            seenGeneration = generation_;
+        }
+        while (runOne(self)) {}
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+
+// --- Thread Pool ---
+// A fixed set of worker threads running parallel loops. Each thread (the caller included) owns
+// a queue of loop indices; it works through its own queue and, once that is empty, steals from
+// the others, so uneven items (e.g. crowded vs empty tiles) still keep every core busy.
+// parallelFor calls must not be nested.
+
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues_.size()); } // Workers + the caller
+
+    // Runs body(i) for every i in [0, count) and returns once all calls have finished
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> items;
+    };
+
+    void workerLoop(unsigned self);
+    bool runOne(unsigned self); // Pops from its own queue, else steals; false when all are empty
+
+    std::vector<std::unique_ptr<Queue>> queues_; // Index 0 belongs to the calling thread
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* body_ = nullptr;
+    size_t generation_ = 0; // Bumped by every parallelFor so sleeping workers know to start
+    std::atomic<size_t> remaining_{0};
+    bool stopping_ = false;
+};
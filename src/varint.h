@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+// LEB128 varints (7 bits per byte, high bit = more bytes follow), as used by the stroke codec
+// and the input log. Signed values are zigzag-mapped first, so small magnitudes of either
+// sign take one byte.
+
+inline void putUnsignedVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Reads one varint; false if it runs past `end` or is longer than `maxBytes`
+inline bool getUnsignedVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value, int maxBytes = 10) {
+    value = 0;
+    for (int shift = 0; shift < 7 * maxBytes; shift += 7) {
+        if (data == end) return false;
+        uint8_t byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline void putVarint(std::vector<uint8_t>& out, int32_t value) {
+    putUnsignedVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31)); // Zigzag
+}
+
+// Signed values are at most 5 bytes long
+inline bool getVarint(const uint8_t*& data, const uint8_t* end, int32_t& value) {
+    uint64_t zigzag;
+    if (!getUnsignedVarint(data, end, zigzag, 5)) return false;
+    uint32_t bits = static_cast<uint32_t>(zigzag);
+    value = static_cast<int32_t>(bits >> 1) ^ -static_cast<int32_t>(bits & 1);
+    return true;
+}